@@ -16,6 +16,12 @@ static bool parse_xml(const char *xml_path, char *title, char *title_id, char *d
 
 int db_rebuild_scanned_items;
 
+// Titles added, changed or removed by the last db_rebuild(). Filled in by the sqlite update hook
+static db_change_t *rebuild_changes;
+static int rebuild_change_cnt;
+static int rebuild_change_size;
+static bool rebuild_changes_lost; // The list ran out of memory, so it is not complete
+
 void db_command_with_callback(const char *command, sqlcmd_callback callback, void *param)
 {
     dash_printf(LEVEL_TRACE, "Processing SQL command %s\n", command);
@@ -231,23 +237,152 @@ bool db_init(char *err_msg, int err_msg_len)
     return !need_game_rebuild;
 }
 
-bool db_rebuild(toml_table_t *paths)
+// Called by sqlite for every row written while db_mutex is held, so the change list needs no lock of its own
+static void rebuild_update_hook(void *param, int op, const char *db_name, const char *table, sqlite3_int64 rowid)
+{
+    (void)param;
+    if (rebuild_changes_lost || strcmp(db_name, "main") != 0 || strcmp(table, SQL_TITLES_NAME) != 0)
+    {
+        return;
+    }
+
+    if (rebuild_change_cnt == rebuild_change_size)
+    {
+        int size = LV_MAX(64, rebuild_change_size * 2);
+        db_change_t *changes = lv_mem_realloc(rebuild_changes, sizeof(db_change_t) * size);
+        if (changes == NULL)
+        {
+            dash_printf(LEVEL_WARN, "Out of memory recording rescan changes. Every page will be read again\n");
+            rebuild_changes_lost = true;
+            return;
+        }
+        rebuild_changes = changes;
+        rebuild_change_size = size;
+    }
+    db_change_t *change = &rebuild_changes[rebuild_change_cnt++];
+    change->op = op;
+    change->db_id = (int)rowid;
+    change->page[0] = '\0';
+}
+
+// Add a title found by a scan. A title that is already in the database keeps its id and launch history
+static void rebuild_store_title(const char *title_id, const char *title, const char *launch_path, const char *page,
+                                const char *developer, const char *publisher, const char *release_date,
+                                const char *overview, const char *rating)
+{
+    sqlite3_stmt *stmt;
+    int rc;
+
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_prepare_v2(db, SQL_TITLE_RESCAN_MARK_SEEN, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+    sqlite3_bind_text(stmt, 1, launch_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, page, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+    bool exists = (sqlite3_changes(db) > 0);
+    SDL_UnlockMutex(db_mutex);
+
+    if (exists)
+    {
+        // Only written if something has changed, so unchanged titles are not reported as changes
+        db_insert(SQL_TITLE_RESCAN_UPDATE, SQL_TITLE_RESCAN_UPDATE_CNT, SQL_TITLE_RESCAN_UPDATE_FORMAT,
+            title_id,
+            title,
+            launch_path,
+            page,
+            developer,
+            publisher,
+            release_date,
+            overview,
+            rating);
+        return;
+    }
+
+    // New titles fill the gaps left by removed ones before going past the highest id
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_prepare_v2(db, SQL_TITLE_RESCAN_NEXT_ID, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+    sqlite3_bind_int(stmt, 1, item_index);
+    sqlite3_step(stmt);
+    item_index = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    SDL_UnlockMutex(db_mutex);
+    if (item_index >= SQL_TITLE_RECENT_FIRST_ID)
+    {
+        dash_printf(LEVEL_ERROR, "No free title id for %s\n", launch_path);
+        return;
+    }
+
+    char item_index_str[8];
+    lv_snprintf(item_index_str, sizeof(item_index_str), "%d", item_index++);
+    db_insert(SQL_TITLE_INSERT, SQL_TITLE_INSERT_CNT, SQL_TITLE_INSERT_FORMAT,
+        item_index_str,
+        title_id,
+        title,
+        launch_path,
+        page,
+        developer,
+        publisher,
+        release_date,
+        overview,
+        "0", // Late played date - "0" = never launch
+        rating);
+    db_insert(SQL_TITLE_RESCAN_MARK_SEEN, 2, "%s,%s", launch_path, page);
+}
+
+int db_rebuild_get_changes(const db_change_t **changes)
+{
+    *changes = rebuild_changes;
+    return (rebuild_changes_lost) ? -1 : rebuild_change_cnt;
+}
+
+void db_rebuild_free_changes(void)
+{
+    lv_mem_free(rebuild_changes);
+    rebuild_changes = NULL;
+    rebuild_change_cnt = 0;
+    rebuild_change_size = 0;
+    rebuild_changes_lost = false;
+}
+
+bool db_rebuild(toml_table_t *paths, bool record_changes)
 {
     toml_array_t *pages = toml_array_in(paths, "pages");
     int num_pages = pages ? (LV_MIN(toml_array_nelem(pages), DASH_MAX_PAGES)) : 0;
+    sqlite3_stmt *stmt;
     int rc;
 
     assert(db);
-    item_index = 0;
     db_rebuild_scanned_items = 0;
+    db_rebuild_free_changes();
 
     // Create the tables if they dont exists
-    rc = sqlite3_exec(db, SQL_TITLE_CREATE_TABLE, NULL, 0, NULL);
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_exec(db, SQL_TITLE_CREATE_TABLE ";"
+                          SQL_TITLE_CREATE_LAUNCH_PATH_INDEX ";"
+                          SQL_TITLE_RESCAN_BEGIN, NULL, 0, NULL);
     assert(rc == SQLITE_OK);
     if (rc != SQLITE_OK)
     {
+        SDL_UnlockMutex(db_mutex);
         return false;
     }
+    item_index = 0;
+
+    // Record every title that is added, changed or removed so the pages showing them can be updated in place
+    if (record_changes)
+    {
+        sqlite3_update_hook(db, rebuild_update_hook, NULL);
+    }
+    SDL_UnlockMutex(db_mutex);
+
+    // Set up the collections first so their membership is filled in as titles are found
+    db_collections_sync(paths);
 
     // Scan through every page from the toml file
     for (int page = 0; page < num_pages; page++)
@@ -277,9 +412,200 @@ bool db_rebuild(toml_table_t *paths)
             parse_folder(name_str.u.s, path_str.u.s, "default.xbe");
         }
     }
+
+    // Anything that was not found again has been removed
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_exec(db, SQL_TITLE_RESCAN_DELETE_UNSEEN, NULL, NULL, NULL);
+    assert(rc == SQLITE_OK);
+    sqlite3_update_hook(db, NULL, NULL);
+
+    // Fill in the page each added or changed title is on now
+    rc = sqlite3_prepare_v2(db, SQL_TITLE_GET_PAGE, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+    for (int i = 0; i < rebuild_change_cnt; i++)
+    {
+        db_change_t *change = &rebuild_changes[i];
+        if (change->op == SQLITE_DELETE)
+        {
+            continue;
+        }
+        sqlite3_bind_int(stmt, 1, change->db_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            strncpy(change->page, (const char *)sqlite3_column_text(stmt, 0), sizeof(change->page) - 1);
+            change->page[sizeof(change->page) - 1] = '\0';
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    SDL_UnlockMutex(db_mutex);
+
+    dash_printf(LEVEL_TRACE, "Rescan found %d changed titles\n", rebuild_change_cnt);
     return true;
 }
 
+typedef struct
+{
+    char *page;
+    toml_datum_t developer;
+    toml_datum_t publisher;
+    toml_datum_t min_rating;
+    toml_datum_t year_from;
+    toml_datum_t year_to;
+} collection_filter_t;
+
+bool db_page_is_collection(toml_table_t *page)
+{
+    static const char *filter_keys[] = {
+        SQL_COLLECTION_DEVELOPER, SQL_COLLECTION_PUBLISHER, SQL_COLLECTION_MIN_RATING,
+        SQL_COLLECTION_YEAR_FROM, SQL_COLLECTION_YEAR_TO};
+
+    for (unsigned int i = 0; page && i < DASH_ARRAY_SIZE(filter_keys); i++)
+    {
+        if (toml_key_exists(page, filter_keys[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run a collection statement with a filter bound to its parameters. Returns true if it returned a row.
+static bool collection_exec(const char *command, const collection_filter_t *filter)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, command, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+
+    sqlite3_bind_text(stmt, 1, filter->page, -1, SQLITE_STATIC);
+    if (sqlite3_bind_parameter_count(stmt) > 1)
+    {
+        if (filter->developer.ok)
+            sqlite3_bind_text(stmt, 2, filter->developer.u.s, -1, SQLITE_STATIC);
+        if (filter->publisher.ok)
+            sqlite3_bind_text(stmt, 3, filter->publisher.u.s, -1, SQLITE_STATIC);
+        if (filter->min_rating.ok)
+            sqlite3_bind_double(stmt, 4, filter->min_rating.u.d);
+        if (filter->year_from.ok)
+            sqlite3_bind_int64(stmt, 5, filter->year_from.u.i);
+        if (filter->year_to.ok)
+            sqlite3_bind_int64(stmt, 6, filter->year_to.u.i);
+    }
+
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+    return (rc == SQLITE_ROW);
+}
+
+void db_collections_sync(toml_table_t *paths)
+{
+    toml_array_t *pages = toml_array_in(paths, "pages");
+    int num_pages = pages ? (LV_MIN(toml_array_nelem(pages), DASH_MAX_PAGES)) : 0;
+    collection_filter_t filters[DASH_MAX_PAGES];
+    int num_filters = 0;
+    int rc;
+
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_exec(db, SQL_COLLECTION_CREATE_FILTERS_TABLE ";"
+                          SQL_COLLECTION_CREATE_MEMBERS_TABLE ";"
+                          SQL_COLLECTION_CREATE_MEMBERS_INDEX ";"
+                          SQL_COLLECTION_CREATE_TRIGGERS, NULL, NULL, NULL);
+    if (rc != SQLITE_OK)
+    {
+        dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+    }
+    assert(rc == SQLITE_OK);
+
+    // Read the filters for every collection page in the toml file
+    for (int page = 0; page < num_pages; page++)
+    {
+        toml_table_t *page_table = toml_table_at(pages, page);
+        if (db_page_is_collection(page_table) == false)
+        {
+            continue;
+        }
+        toml_datum_t name_str = toml_string_in(page_table, "name");
+        if (name_str.ok == 0)
+        {
+            continue;
+        }
+
+        collection_filter_t *filter = &filters[num_filters++];
+        filter->page = name_str.u.s;
+        filter->developer = toml_string_in(page_table, SQL_COLLECTION_DEVELOPER);
+        filter->publisher = toml_string_in(page_table, SQL_COLLECTION_PUBLISHER);
+        filter->min_rating = toml_double_in(page_table, SQL_COLLECTION_MIN_RATING);
+        filter->year_from = toml_int_in(page_table, SQL_COLLECTION_YEAR_FROM);
+        filter->year_to = toml_int_in(page_table, SQL_COLLECTION_YEAR_TO);
+
+        // Allow a whole number rating like "min_rating = 8"
+        if (filter->min_rating.ok == 0)
+        {
+            toml_datum_t min_rating = toml_int_in(page_table, SQL_COLLECTION_MIN_RATING);
+            filter->min_rating.ok = min_rating.ok;
+            filter->min_rating.u.d = (double)min_rating.u.i;
+        }
+    }
+
+    // Forget collections that are no longer in the toml file. The pages are collected first so the table is not
+    // changed while it is being read. The table only holds the pages from the last sync so they all fit.
+    collection_filter_t removed[DASH_MAX_PAGES] = {0};
+    int num_removed = 0;
+    sqlite3_stmt *stmt;
+    rc = sqlite3_prepare_v2(db, SQL_COLLECTION_FILTER_GET_PAGES, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+    while (num_removed < DASH_MAX_PAGES && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char *page = (const char *)sqlite3_column_text(stmt, 0);
+        bool found = false;
+        for (int i = 0; i < num_filters && found == false; i++)
+        {
+            found = (strcmp(filters[i].page, page) == 0);
+        }
+        if (found == false)
+        {
+            removed[num_removed].page = lv_mem_alloc(strlen(page) + 1);
+            if (removed[num_removed].page != NULL)
+            {
+                strcpy(removed[num_removed++].page, page);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    for (int i = 0; i < num_removed; i++)
+    {
+        dash_printf(LEVEL_TRACE, "Removing collection \"%s\"\n", removed[i].page);
+        collection_exec(SQL_COLLECTION_FILTER_DELETE, &removed[i]);
+        collection_exec(SQL_COLLECTION_MEMBERS_CLEAR, &removed[i]);
+        lv_mem_free(removed[i].page);
+    }
+
+    // Only collections that are new or have changed need their titles worked out again. The rest were kept up
+    // to date by the triggers.
+    for (int i = 0; i < num_filters; i++)
+    {
+        collection_filter_t *filter = &filters[i];
+        if (collection_exec(SQL_COLLECTION_FILTER_UNCHANGED, filter) == false)
+        {
+            dash_printf(LEVEL_TRACE, "Rebuilding collection \"%s\"\n", filter->page);
+            collection_exec(SQL_COLLECTION_FILTER_SET, filter);
+            collection_exec(SQL_COLLECTION_MEMBERS_CLEAR, filter);
+            collection_exec(SQL_COLLECTION_MEMBERS_FILL, filter);
+        }
+
+        free(filter->page);
+        if (filter->developer.ok)
+            free(filter->developer.u.s);
+        if (filter->publisher.ok)
+            free(filter->publisher.u.s);
+    }
+    SDL_UnlockMutex(db_mutex);
+}
+
 static bool get_xml_str(char *xml, sxmltok_t *tokens, int num_tokens, char *key, char *buf, int buf_len)
 {
     char str[32];
@@ -480,23 +806,10 @@ static void parse_folder(const char *page_title, const char *folderPath, const c
 
         
         // Insert it into the database
-        char item_index_str[8];
         char rating_str[8];
-        lv_snprintf(item_index_str, sizeof(item_index_str), "%d", item_index++);
         lv_snprintf(rating_str, sizeof(rating_str), "%1.1f", rating);
-
-        db_insert(SQL_TITLE_INSERT, SQL_TITLE_INSERT_CNT, SQL_TITLE_INSERT_FORMAT,
-            item_index_str,
-            title_id,
-            title,
-            filePath,
-            page_title,
-            developer,
-            publisher,
-            release_date,
-            overview,
-            "0", // Late played date - "0" = never launch
-            rating_str);
+        rebuild_store_title(title_id, title, filePath, page_title, developer, publisher, release_date,
+                            overview, rating_str);
 
         db_rebuild_scanned_items++;
     } while (FindNextFile(hFind, &findData));
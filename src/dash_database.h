@@ -176,6 +176,139 @@ enum {
 #define SQL_TITLE_INSERT_FORMAT "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s"
 #define SQL_TITLE_INSERT_CNT 11
 
+// A rescan matches the titles it finds to the existing rows by launch path and page, so they keep their id and
+// launch history. A title found by more than one page has a row on each. Rows are only written if something about
+// the title has changed, and the rows that were not found again are deleted at the end, so a title that moved to
+// another page is deleted from the old one and inserted on the new one.
+#define SQL_TITLE_CREATE_LAUNCH_PATH_INDEX \
+    "CREATE INDEX IF NOT EXISTS " SQL_TITLES_NAME "_" SQL_TITLE_LAUNCH_PATH \
+    " ON " SQL_TITLES_NAME " (" SQL_TITLE_LAUNCH_PATH ")"
+
+#define SQL_TITLE_RESCAN_SEEN_NAME "temp.rescan_seen"
+
+#define SQL_TITLE_RESCAN_BEGIN \
+    "CREATE TEMP TABLE IF NOT EXISTS rescan_seen (" SQL_TITLE_DB_ID " INTEGER PRIMARY KEY);" \
+    "DELETE FROM " SQL_TITLE_RESCAN_SEEN_NAME
+
+// Titles on the Recent page are numbered from here up. Scanned titles take the lowest free id from ?1 up, so ids
+// freed by removed titles are used again and the two ranges never meet.
+#define SQL_TITLE_RECENT_FIRST_ID 10000
+
+#define SQL_TITLE_RESCAN_NEXT_ID                                                                             \
+    "SELECT MIN(next_id) FROM (SELECT ?1 AS next_id UNION ALL SELECT " SQL_TITLE_DB_ID " + 1 FROM "          \
+    SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " >= ?1) WHERE NOT EXISTS (SELECT 1 FROM " SQL_TITLES_NAME      \
+    " WHERE " SQL_TITLE_DB_ID " = next_id)"
+
+#define SQL_TITLE_RESCAN_MARK_SEEN                                                                    \
+    "INSERT OR REPLACE INTO " SQL_TITLE_RESCAN_SEEN_NAME " SELECT " SQL_TITLE_DB_ID " FROM " SQL_TITLES_NAME \
+    " WHERE " SQL_TITLE_LAUNCH_PATH " = ?1 AND " SQL_TITLE_PAGE " = ?2"
+
+#define SQL_TITLE_RESCAN_UPDATE                                                                    \
+    "UPDATE " SQL_TITLES_NAME " SET "                                                              \
+            SQL_TITLE_TITLE_ID " = ?1, " SQL_TITLE_NAME " = ?2, "                                  \
+            SQL_TITLE_DEVELOPER " = ?5, " SQL_TITLE_PUBLISHER " = ?6, "                            \
+            SQL_TITLE_RELEASE_DATE " = ?7, " SQL_TITLE_OVERVIEW " = ?8, " SQL_TITLE_RATING " = ?9" \
+    " WHERE " SQL_TITLE_LAUNCH_PATH " = ?3 AND " SQL_TITLE_PAGE " = ?4 AND ("                     \
+            SQL_TITLE_TITLE_ID " IS NOT ?1 OR " SQL_TITLE_NAME " IS NOT ?2 OR "                    \
+            SQL_TITLE_DEVELOPER " IS NOT ?5 OR "                                                   \
+            SQL_TITLE_PUBLISHER " IS NOT ?6 OR " SQL_TITLE_RELEASE_DATE " IS NOT ?7 OR "           \
+            SQL_TITLE_OVERVIEW " IS NOT ?8 OR " SQL_TITLE_RATING " IS NOT ?9)"
+#define SQL_TITLE_RESCAN_UPDATE_FORMAT "%s,%s,%s,%s,%s,%s,%s,%s,%s"
+#define SQL_TITLE_RESCAN_UPDATE_CNT 9
+
+#define SQL_TITLE_RESCAN_DELETE_UNSEEN \
+    "DELETE FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_PAGE " != \"__RECENT__\" AND " \
+    SQL_TITLE_DB_ID " NOT IN (SELECT " SQL_TITLE_DB_ID " FROM " SQL_TITLE_RESCAN_SEEN_NAME ")"
+
+#define SQL_TITLE_GET_PAGE \
+    "SELECT " SQL_TITLE_PAGE " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " = ?"
+
+// Collection pages are defined by filters in the toml file instead of search paths. The titles that match each
+// filter are kept in a membership table. Triggers keep it up to date as titles are inserted, updated or deleted,
+// so opening a collection is an indexed lookup instead of a scan of every title.
+#define SQL_COLLECTION_FILTERS_NAME "collection_filters"
+#define SQL_COLLECTION_MEMBERS_NAME "collection_members"
+#define SQL_COLLECTION_PAGE "page"
+#define SQL_COLLECTION_DEVELOPER "developer"
+#define SQL_COLLECTION_PUBLISHER "publisher"
+#define SQL_COLLECTION_MIN_RATING "min_rating"
+#define SQL_COLLECTION_YEAR_FROM "year_from"
+#define SQL_COLLECTION_YEAR_TO "year_to"
+
+#define SQL_COLLECTION_CREATE_FILTERS_TABLE                          \
+    "CREATE TABLE IF NOT EXISTS " SQL_COLLECTION_FILTERS_NAME " ("   \
+            SQL_COLLECTION_PAGE       " TEXT PRIMARY KEY,"           \
+            SQL_COLLECTION_DEVELOPER  " TEXT,"                       \
+            SQL_COLLECTION_PUBLISHER  " TEXT,"                       \
+            SQL_COLLECTION_MIN_RATING " FLOAT,"                      \
+            SQL_COLLECTION_YEAR_FROM  " INTEGER,"                    \
+            SQL_COLLECTION_YEAR_TO    " INTEGER)"
+
+#define SQL_COLLECTION_CREATE_MEMBERS_TABLE                          \
+    "CREATE TABLE IF NOT EXISTS " SQL_COLLECTION_MEMBERS_NAME " ("   \
+            SQL_COLLECTION_PAGE       " TEXT,"                       \
+            SQL_TITLE_DB_ID           " INTEGER,"                    \
+            "PRIMARY KEY (" SQL_COLLECTION_PAGE ", " SQL_TITLE_DB_ID ")) WITHOUT ROWID"
+
+#define SQL_COLLECTION_CREATE_MEMBERS_INDEX                          \
+    "CREATE INDEX IF NOT EXISTS " SQL_COLLECTION_MEMBERS_NAME "_" SQL_TITLE_DB_ID \
+    " ON " SQL_COLLECTION_MEMBERS_NAME " (" SQL_TITLE_DB_ID ")"
+
+// True if the title row t matches the filter row f. Titles only on the recent page are never in a collection.
+#define SQL_COLLECTION_MATCH(t)                                                                                 \
+    "(f." SQL_COLLECTION_DEVELOPER " IS NULL OR " t "." SQL_TITLE_DEVELOPER " = f." SQL_COLLECTION_DEVELOPER    \
+        " COLLATE NOCASE) AND "                                                                                 \
+    "(f." SQL_COLLECTION_PUBLISHER " IS NULL OR " t "." SQL_TITLE_PUBLISHER " = f." SQL_COLLECTION_PUBLISHER    \
+        " COLLATE NOCASE) AND "                                                                                 \
+    "(f." SQL_COLLECTION_MIN_RATING " IS NULL OR " t "." SQL_TITLE_RATING " >= f." SQL_COLLECTION_MIN_RATING ") AND " \
+    "(f." SQL_COLLECTION_YEAR_FROM " IS NULL OR CAST(substr(" t "." SQL_TITLE_RELEASE_DATE ", 1, 4) AS INTEGER)" \
+        " >= f." SQL_COLLECTION_YEAR_FROM ") AND "                                                             \
+    "(f." SQL_COLLECTION_YEAR_TO " IS NULL OR CAST(substr(" t "." SQL_TITLE_RELEASE_DATE ", 1, 4) AS INTEGER)"   \
+        " <= f." SQL_COLLECTION_YEAR_TO ") AND "                                                               \
+    t "." SQL_TITLE_PAGE " != \"__RECENT__\""
+
+#define SQL_COLLECTION_ADD_TITLE(t)                                                                             \
+    "INSERT OR IGNORE INTO " SQL_COLLECTION_MEMBERS_NAME " SELECT f." SQL_COLLECTION_PAGE ", " t "." SQL_TITLE_DB_ID \
+    " FROM " SQL_COLLECTION_FILTERS_NAME " f WHERE " SQL_COLLECTION_MATCH(t)
+
+#define SQL_COLLECTION_CREATE_TRIGGERS                                                                          \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_COLLECTION_MEMBERS_NAME "_insert AFTER INSERT ON " SQL_TITLES_NAME      \
+    " BEGIN " SQL_COLLECTION_ADD_TITLE("NEW") "; END;"                                                          \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_COLLECTION_MEMBERS_NAME "_update AFTER UPDATE OF "                      \
+    SQL_TITLE_PAGE ", " SQL_TITLE_DEVELOPER ", " SQL_TITLE_PUBLISHER ", " SQL_TITLE_RELEASE_DATE ", "            \
+    SQL_TITLE_RATING " ON " SQL_TITLES_NAME " BEGIN "                                                           \
+    "DELETE FROM " SQL_COLLECTION_MEMBERS_NAME " WHERE " SQL_TITLE_DB_ID " = OLD." SQL_TITLE_DB_ID "; "          \
+    SQL_COLLECTION_ADD_TITLE("NEW") "; END;"                                                                    \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_COLLECTION_MEMBERS_NAME "_delete AFTER DELETE ON " SQL_TITLES_NAME      \
+    " BEGIN DELETE FROM " SQL_COLLECTION_MEMBERS_NAME " WHERE " SQL_TITLE_DB_ID " = OLD." SQL_TITLE_DB_ID "; END;"
+
+// Parameters are page, developer, publisher, min_rating, year_from, year_to. Unused filters are bound as NULL.
+#define SQL_COLLECTION_FILTER_UNCHANGED                                                                         \
+    "SELECT 1 FROM " SQL_COLLECTION_FILTERS_NAME " WHERE " SQL_COLLECTION_PAGE " = ?1 AND "                     \
+    SQL_COLLECTION_DEVELOPER " IS ?2 AND " SQL_COLLECTION_PUBLISHER " IS ?3 AND "                               \
+    SQL_COLLECTION_MIN_RATING " IS ?4 AND " SQL_COLLECTION_YEAR_FROM " IS ?5 AND " SQL_COLLECTION_YEAR_TO " IS ?6"
+
+#define SQL_COLLECTION_FILTER_SET \
+    "INSERT OR REPLACE INTO " SQL_COLLECTION_FILTERS_NAME " VALUES (?1, ?2, ?3, ?4, ?5, ?6)"
+
+#define SQL_COLLECTION_MEMBERS_CLEAR \
+    "DELETE FROM " SQL_COLLECTION_MEMBERS_NAME " WHERE " SQL_COLLECTION_PAGE " = ?1"
+
+#define SQL_COLLECTION_MEMBERS_FILL                                                                             \
+    "INSERT OR IGNORE INTO " SQL_COLLECTION_MEMBERS_NAME " SELECT f." SQL_COLLECTION_PAGE ", t." SQL_TITLE_DB_ID \
+    " FROM " SQL_COLLECTION_FILTERS_NAME " f, " SQL_TITLES_NAME " t WHERE f." SQL_COLLECTION_PAGE " = ?1 AND "   \
+    SQL_COLLECTION_MATCH("t")
+
+#define SQL_COLLECTION_FILTER_GET_PAGES \
+    "SELECT " SQL_COLLECTION_PAGE " FROM " SQL_COLLECTION_FILTERS_NAME
+
+#define SQL_COLLECTION_FILTER_DELETE \
+    "DELETE FROM " SQL_COLLECTION_FILTERS_NAME " WHERE " SQL_COLLECTION_PAGE " = ?1"
+
+#define SQL_TITLE_GET_SORTED_COLLECTION                                                                         \
+    "SELECT %s FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " IN (SELECT " SQL_TITLE_DB_ID " FROM "          \
+    SQL_COLLECTION_MEMBERS_NAME " WHERE " SQL_COLLECTION_PAGE " = \"%s\") ORDER BY %s COLLATE NOCASE %s"
+
 #define SQL_SETTINGS_DELETE_TABLE \
     "DROP TABLE IF EXISTS "SQL_SETTINGS_NAME
 
@@ -200,10 +333,24 @@ enum {
 
 typedef int (*sqlcmd_callback)(void*,int,char**, char**);
 
+// A title that was added, changed or removed by db_rebuild()
+typedef struct
+{
+    int op;        // SQLITE_INSERT, SQLITE_UPDATE or SQLITE_DELETE
+    int db_id;     // SQL_TITLE_DB_ID of the title
+    char page[32]; // Page the title is on now. Empty if it was deleted
+} db_change_t;
+
 bool db_open();
 bool db_close();
 bool db_init(char *err_msg, int err_msg_len);
-bool db_rebuild(toml_table_t *paths);
+// record_changes keeps a list of the titles added, changed or removed for db_rebuild_get_changes().
+// It returns -1 if the list could not be kept in full, then every page needs reading again.
+bool db_rebuild(toml_table_t *paths, bool record_changes);
+int db_rebuild_get_changes(const db_change_t **changes);
+void db_rebuild_free_changes(void);
+bool db_page_is_collection(toml_table_t *page);
+void db_collections_sync(toml_table_t *paths);
 void db_command_with_callback(const char *command, sqlcmd_callback callback, void *param);
 void db_insert(const char *command, int argc, const char *format, ...);
 void db_insert_blob(const char *command, void *blob, int len);
@@ -17,6 +17,8 @@ static char *toml_default = ""
                             "# All paths should use a forward slash \"/\" Do not use \"\\\".\n"
                             "# On a syntax error, it will reset back to default\n"
                             "# Page names must be unique\n"
+                            "# A page can be a collection of titles from the other pages instead of having paths. Filter by any of\n"
+                            "# developer = \"...\", publisher = \"...\", min_rating = 8.0, year_from = 2001, year_to = 2004\n"
                             "[[pages]]\n"
                             "name = \"Recent\"\n"
                             "\n"
@@ -136,7 +138,7 @@ static void create_warning_box(const char *str)
 static int db_rebuild_thread_f(void *param)
 {
     int *complete = param;
-    db_rebuild(dash_search_paths);
+    db_rebuild(dash_search_paths, false);
     *complete = 1;
     lvgl_getlock();
     lv_obj_clean(lv_scr_act());
@@ -145,6 +147,33 @@ static int db_rebuild_thread_f(void *param)
     return 0;
 }
 
+// Scan the search paths again while the dash is running. Only the pages whose titles changed are read again,
+// and they keep their selection, scroll position and thumbnails.
+static SDL_atomic_t rescan_running;
+static int db_rescan_thread_f(void *param)
+{
+    (void)param;
+    const db_change_t *changes;
+    db_rebuild(dash_search_paths, true);
+    int change_cnt = db_rebuild_get_changes(&changes);
+    lvgl_getlock();
+    dash_scroller_apply_changes(changes, change_cnt);
+    lvgl_removelock();
+    db_rebuild_free_changes();
+    SDL_AtomicSet(&rescan_running, 0);
+    return 0;
+}
+
+void dash_rescan(void)
+{
+    if (SDL_AtomicCAS(&rescan_running, 0, 1) == SDL_FALSE)
+    {
+        return;
+    }
+    SDL_Thread *thread = SDL_CreateThread(db_rescan_thread_f, "db_rescan_thread_f", NULL);
+    SDL_DetachThread(thread);
+}
+
 static int db_rebuild_progress_thread_f(void *param)
 {
     lv_obj_t *label = param;
@@ -206,6 +235,7 @@ void dash_init(void)
     // Check that the database is valid (Correct tables, and columns). Otherwise begin a database rebuild
     if (db_init(err_msg_db, sizeof(err_msg_db)) == true)
     {
+        db_collections_sync(dash_search_paths);
         dash_create();
     }
     else
@@ -157,10 +157,10 @@ static void xbe_launch(void *param)
         // Otherwise add it to a page called "Recent" with current LAUNCH_DATETIME
         const char *query = "SELECT MAX(" SQL_TITLE_DB_ID ") FROM " SQL_TITLES_NAME
                             " WHERE " SQL_TITLE_PAGE " = \"__RECENT__\"";
-        int db_id_max = 10000;
+        int db_id_max = SQL_TITLE_RECENT_FIRST_ID;
         db_command_with_callback(query, recent_title_get_last_id_cb, &db_id_max);
         db_id_max++;
-        db_id_max = LV_MAX(10000, db_id_max);
+        db_id_max = LV_MAX(SQL_TITLE_RECENT_FIRST_ID, db_id_max);
 
         char item_index_str[8];
         lv_snprintf(item_index_str, sizeof(item_index_str), "%d", db_id_max);
@@ -242,6 +242,12 @@ static void dash_rebuild_database(void *param)
     db_command_with_callback(SQL_TITLE_DELETE_ENTRIES, NULL, NULL);
 }
 
+static void dash_rescan_titles(void *param)
+{
+    (void)param;
+    dash_rescan();
+}
+
 static void dash_clear_recent(void *param)
 {
     (void)param;
@@ -301,6 +307,7 @@ static void dash_utilities(void *param)
         {
             {"XBE Launcher", dash_open_xbe_launcher, NULL, NULL},
             {"EEPROM Config", dash_open_eeprom_config, NULL, NULL},
+            {"Rescan Titles", dash_rescan_titles, NULL, NULL},
             {"Clear Recent Titles", dash_clear_recent, NULL, "Accept \"Clear Recent Titles\""},
             {"Flush Cache Partitions", dash_flush_cache, NULL, "Accept \"Flush Cache Partitions\""},
             {"Mark Database Reset at Reboot", dash_rebuild_database, NULL, "Accept \"Database Reset\""},
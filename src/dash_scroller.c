@@ -2,15 +2,14 @@
 // SPDX-FileCopyrightText: 2022 Ryzee119
 
 #include "lithiumx.h"
-#include <src/misc/lv_lru.h>
 #include <src/misc/lv_ll.h>
+#include <ctype.h>
 
 parse_handle_t *parsers[DASH_MAX_PAGES];
 static lv_obj_t *page_tiles;
 static lv_obj_t *label_footer;
+static lv_obj_t *label_jump;
 static int page_current;
-static lv_lru_t *thumbnail_cache;
-static size_t thumbnail_cache_size = (16 * 1024 * 1024);
 
 typedef struct
 {
@@ -18,79 +17,792 @@ typedef struct
 } jpeg_ll_value_t;
 static lv_ll_t jpeg_decomp_list;
 
+// Off screen thumbnails that are being prefetched have this added to their decode priority, so anything
+// visible is always decoded first.
+#define THUMBNAIL_PREFETCH_PRIORITY 0x10000
+#define THUMBNAIL_ADJACENT_PRIORITY 0x20000
+static int scroll_direction = 1; // 1 if the user last moved forward through the list, -1 if backwards
+
+#if DASH_THUMBNAIL_DXT1
+#define THUMBNAIL_COLOUR_DEPTH JPEG_DECODER_DXT1
+#define THUMBNAIL_IMG_CF LV_IMG_CF_DXT1
+#elif DASH_THUMBNAIL_RGB565
+#define THUMBNAIL_COLOUR_DEPTH 16
+#define THUMBNAIL_IMG_CF ((LV_COLOR_DEPTH == 16) ? LV_IMG_CF_TRUE_COLOR : LV_IMG_CF_RGB565)
+#else
+#define THUMBNAIL_COLOUR_DEPTH LV_COLOR_DEPTH
+#define THUMBNAIL_IMG_CF LV_IMG_CF_TRUE_COLOR
+#endif
+
+// Work out the grid for a scroller from its size and padding. Called once when the scroller is created.
+static void grid_init(parse_handle_t *p)
+{
+    scroller_grid_t *g = &p->grid;
+    g->cell_w = DASH_THUMBNAIL_WIDTH;
+    g->cell_h = DASH_THUMBNAIL_HEIGHT;
+    g->pitch_x = g->cell_w + lv_obj_get_style_pad_column(p->scroller, LV_PART_MAIN);
+    g->pitch_y = g->cell_h + lv_obj_get_style_pad_row(p->scroller, LV_PART_MAIN);
+    // The last cell in a row does not need the padding after it
+    g->cols = LV_MAX(1, (lv_obj_get_content_width(p->scroller) + g->pitch_x - g->cell_w) / g->pitch_x);
+}
+
+static int grid_row(const scroller_grid_t *g, int index)
+{
+    return index / g->cols;
+}
+
+static int grid_col(const scroller_grid_t *g, int index)
+{
+    return index % g->cols;
+}
+
+static lv_coord_t grid_get_y(const scroller_grid_t *g, int index)
+{
+    return grid_row(g, index) * g->pitch_y;
+}
+
+// Number of rows with at least part of a cell inside h pixels
+static int grid_rows_in(const scroller_grid_t *g, lv_coord_t h)
+{
+    return (h + g->pitch_y - 1) / g->pitch_y;
+}
+
+// Height of the whole grid for cnt titles
+static lv_coord_t grid_get_height(const scroller_grid_t *g, int cnt)
+{
+    int rows = (cnt + g->cols - 1) / g->cols;
+    return (rows > 0) ? (rows * g->pitch_y - (g->pitch_y - g->cell_h)) : 0;
+}
+
+static title_t *get_title(parse_handle_t *p, int index)
+{
+    return &p->titles[p->order[index]];
+}
+
+// Get the item container showing the title at grid position index, or NULL if it is not in view
+static lv_obj_t *get_item(parse_handle_t *p, int index)
+{
+    if (p->item_cnt == 0 || index < 0 || index >= p->title_cnt)
+    {
+        return NULL;
+    }
+    lv_obj_t *item_container = p->items[index % p->item_cnt];
+    scroller_item_t *item = item_container->user_data;
+    return (item->index == index) ? item_container : NULL;
+}
+
+// The scroller has the input focus, so give the item the same states it would have if it was focused itself.
+// The highlight comes from titleview_image_container_focused_style, so this does not touch any local styles.
+static void item_set_focused(lv_obj_t *item_container, bool focused)
+{
+    if (focused)
+    {
+        lv_obj_add_state(item_container, LV_STATE_FOCUSED | LV_STATE_FOCUS_KEY);
+    }
+    else
+    {
+        lv_obj_clear_state(item_container, LV_STATE_FOCUSED | LV_STATE_FOCUS_KEY);
+    }
+}
+
+// Highlight the selected title and show its name in the footer
+static void scroller_show_focus(parse_handle_t *p)
+{
+    lv_obj_t *item_container = get_item(p, p->focus_index);
+    if (item_container)
+    {
+        item_set_focused(item_container, true);
+    }
+    lv_label_set_text(label_footer, (p->title_cnt > 0) ? get_title(p, p->focus_index)->title : "No item selected");
+}
+
+static void scroller_set_focus(parse_handle_t *p, int index)
+{
+    lv_obj_t *item_container = get_item(p, p->focus_index);
+    if (item_container)
+    {
+        item_set_focused(item_container, false);
+    }
+    p->focus_index = index;
+    scroller_show_focus(p);
+}
+
+static void page_build(parse_handle_t *parser);
+
 void dash_scroller_set_page()
 {
     toml_array_t *pages = toml_array_in(dash_search_paths, "pages");
     int page_max = LV_MIN(toml_array_nelem(pages), DASH_MAX_PAGES);
     page_current = LV_CLAMP(0, page_current, page_max - 1);
     lv_obj_set_tile_id(page_tiles, page_current, 0, LV_ANIM_ON);
-    lv_obj_t *tile = lv_tileview_get_tile_act(page_tiles);
-    lv_obj_t *scroller = lv_obj_get_child(tile, 0);
-    int *current_index = (int *)&scroller->user_data;
-    *current_index = LV_MAX(1, *current_index);
 
-    assert(lv_obj_get_child_cnt(scroller) >= 1);
+    parse_handle_t *p = parsers[page_current];
+    assert(p);
+    page_build(p);
+    p->last_visit = lv_tick_get();
+    if (p->title_cnt > 0)
+    {
+        p->focus_index = LV_CLAMP(0, p->focus_index, p->title_cnt - 1);
+    }
+
+    // The scroller keeps the input focus for the whole page and moves the highlight between its items
+    dash_focus_set_final(p->scroller);
+    dash_focus_change(p->scroller);
+}
+
+static void thumbnail_set_canvas(lv_obj_t *image_container, void *img, int w, int h)
+{
+    scroller_item_t *item = image_container->user_data;
+
+    if (item->canvas == NULL)
+    {
+        item->canvas = lv_canvas_create(image_container);
+        lv_obj_mark_layout_as_dirty(item->canvas);
+    }
+    // The decoder already resampled the image to the thumbnail size so it can be blitted directly
+    lv_canvas_set_buffer(item->canvas, img, w, h, THUMBNAIL_IMG_CF);
+    lv_obj_clear_flag(item->canvas, LV_OBJ_FLAG_HIDDEN);
+}
+
+// Show the full image, replacing the preview if there is one.
+static void thumbnail_show(lv_obj_t *image_container, void *img, int w, int h)
+{
+    scroller_item_t *item = image_container->user_data;
+
+    item->jpg_info->image = img;
+    item->jpg_info->w = w;
+    item->jpg_info->h = h;
+    thumbnail_set_canvas(image_container, img, w, h);
+
+    jpeg_decoder_free_image(item->jpg_info->preview_mem);
+    item->jpg_info->preview_mem = NULL;
+}
+
+// The thumbnail memory cache needs this image back. Remove it from the item, it will be loaded
+// again next time it is needed.
+static void thumbnail_release(dash_thumbcache_user_t *user)
+{
+    jpg_info_t *jpg_info = user->user_data;
+    scroller_item_t *item = jpg_info->image_container->user_data;
+    assert(lv_obj_is_valid(item->canvas));
+    lv_obj_add_flag(item->canvas, LV_OBJ_FLAG_HIDDEN);
+    jpg_info->image = NULL;
+}
+
+// The item was unbound while one of its decoder callbacks was waiting for the lvgl lock. The callback
+// owns jpg_info now and frees it. Must be called with the lvgl lock held.
+static bool jpg_info_orphaned(jpg_info_t *jpg_info)
+{
+    if (jpg_info->image_container != NULL)
+    {
+        return false;
+    }
+    lv_mem_free(jpg_info);
+    return true;
+}
 
-    lv_obj_t *focus_item = lv_obj_get_child(scroller, *current_index);
-    if (lv_obj_is_valid(focus_item) == false)
+static jpg_info_t *jpg_info_create(lv_obj_t *image_container)
+{
+    jpg_info_t *jpg_info = lv_mem_alloc(sizeof(jpg_info_t));
+    assert(jpg_info);
+    if (jpg_info == NULL)
     {
-        // We were are trying to focus an invalid object, revert to index 0 which should always
-        // be present
-        *current_index = 0;
-        focus_item = lv_obj_get_child(scroller, *current_index);
-        assert(lv_obj_is_valid(scroller));
+        return NULL;
     }
+    lv_memset(jpg_info, 0, sizeof(jpg_info_t));
+    jpg_info->cache_user.user_data = jpg_info;
+    jpg_info->image_container = image_container;
+    return jpg_info;
+}
+
+// A quick blurred version of the thumbnail to show while the full decode runs
+static void jpg_preview_cb(void *img, void *mem, int w, int h, void *user_data)
+{
+    jpg_info_t *jpg_info = user_data;
 
-    dash_focus_set_final(lv_obj_get_child(scroller, 0));
-    dash_focus_change(focus_item);
+    lvgl_getlock();
+    if (jpg_info_orphaned(jpg_info))
+    {
+        lvgl_removelock();
+        jpeg_decoder_free_image(mem);
+        return;
+    }
+    // Only show it if the job has not been aborted and there is nothing better on screen already
+    if (jpg_info->decomp_handle == NULL || jpg_info->image != NULL || jpg_info->preview_mem != NULL)
+    {
+        lvgl_removelock();
+        jpeg_decoder_free_image(mem);
+        return;
+    }
+    jpg_info->preview_mem = mem;
+    thumbnail_set_canvas(jpg_info->image_container, img, w, h);
+    lvgl_removelock();
 }
 
 static void jpg_decompression_complete_cb(void *img, void *mem, int w, int h, void *user_data)
 {
-    lv_obj_t *image_container = user_data;
-    title_t *t = image_container->user_data;
+    jpg_info_t *jpg_info = user_data;
 
+    lvgl_getlock();
+    if (jpg_info_orphaned(jpg_info))
+    {
+        lvgl_removelock();
+        jpeg_decoder_free_image(mem);
+        return;
+    }
+    lv_obj_t *image_container = jpg_info->image_container;
+    scroller_item_t *item = image_container->user_data;
+    jpg_info->decomp_handle = NULL;
     if (img == NULL)
     {
-        t->jpg_info->decomp_handle = NULL;
+        // Corrupt or unreadable. Don't keep reading and decoding it again every time the item is drawn
+        item->title->thumb_failed = true;
+        lvgl_removelock();
         return;
     }
+    img = dash_thumbcache_mem_insert(&jpg_info->cache_user, item->title->thumb_path,
+                                     item->title->file_size, item->title->write_time, mem, img, w, h);
+    if (img != NULL)
+    {
+        thumbnail_show(image_container, img, w, h);
+    }
+    lvgl_removelock();
+}
 
-    lvgl_getlock();
+static bool page_is_adjacent(parse_handle_t *p)
+{
+    for (int i = page_current - 1; i <= page_current + 1; i += 2)
+    {
+        if (i >= 0 && i < DASH_MAX_PAGES && parsers[i] == p)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Get the decode priority for the thumbnail of an item. Lower is more important.
+// Visible thumbnails are ranked by their distance from the focused item. Thumbnails in the next few rows
+// past the edge of the screen in the scroll direction are prefetched behind them. Returns -1 if the
+// thumbnail is not needed right now.
+static int thumbnail_get_priority(lv_obj_t *image_container)
+{
+    scroller_item_t *item = image_container->user_data;
+    lv_obj_t *scroller = lv_obj_get_parent(image_container);
+    parse_handle_t *p = scroller->user_data;
+    const scroller_grid_t *g = &p->grid;
 
-    t->jpg_info->mem = mem;
-    t->jpg_info->image = img;
-    t->jpg_info->w = w;
-    t->jpg_info->h = h;
-    t->jpg_info->decomp_handle = NULL;
+    int row = grid_row(g, item->index) - grid_row(g, p->focus_index);
+    int col = grid_col(g, item->index) - grid_col(g, p->focus_index);
+    int distance = LV_ABS(row) * g->cols + LV_ABS(col);
 
-    t->jpg_info->canvas = lv_canvas_create(image_container);
-    lv_canvas_set_buffer(t->jpg_info->canvas, img, w, h, LV_IMG_CF_TRUE_COLOR);
+    if (lv_obj_is_visible(image_container))
+    {
+        return distance;
+    }
 
-    lv_img_set_size_mode(t->jpg_info->canvas, LV_IMG_SIZE_MODE_REAL);
-    lv_img_set_zoom(t->jpg_info->canvas, DASH_THUMBNAIL_WIDTH * 256 / w);
-    lv_obj_mark_layout_as_dirty(t->jpg_info->canvas);
+    int prefetch_rows = grid_rows_in(g, lv_obj_get_content_height(scroller)) + DASH_THUMBNAIL_PREFETCH_ROWS;
+    int rows_ahead = row * scroll_direction;
+    if (lv_obj_get_parent(scroller) == lv_tileview_get_tile_act(page_tiles) &&
+        rows_ahead > 0 && rows_ahead <= prefetch_rows)
+    {
+        return THUMBNAIL_PREFETCH_PRIORITY + distance;
+    }
 
-    lv_lru_set(thumbnail_cache, t, sizeof(title_t *), t, w * h * ((LV_COLOR_DEPTH + 7) / 8));
-    lvgl_removelock();
+    // Keep the first screen of the pages either side of the current one, see page_prefetch_adjacent()
+    if (page_is_adjacent(p))
+    {
+        int top_row = LV_MAX(0, lv_obj_get_scroll_y(scroller)) / g->pitch_y;
+        int screen_row = grid_row(g, item->index) - top_row;
+        if (screen_row >= 0 && screen_row < grid_rows_in(g, lv_obj_get_content_height(scroller)))
+        {
+            return THUMBNAIL_ADJACENT_PRIORITY + screen_row * g->cols + grid_col(g, item->index);
+        }
+    }
+    return -1;
+}
+
+// Show the thumbnail straight from the memory cache if it is there
+static bool thumbnail_show_cached(lv_obj_t *image_container)
+{
+    scroller_item_t *item = image_container->user_data;
+    int w, h;
+
+    void *img = dash_thumbcache_mem_attach(&item->jpg_info->cache_user, item->title->thumb_path,
+                                           item->title->file_size, item->title->write_time, &w, &h);
+    if (img != NULL)
+    {
+        thumbnail_show(image_container, img, w, h);
+        return true;
+    }
+    return false;
+}
+
+// Show a thumbnail straight from the memory cache if we can. Otherwise queue it for decompression,
+// or just update its priority if it is already queued.
+static void thumbnail_request(lv_obj_t *image_container, int priority)
+{
+    scroller_item_t *item = image_container->user_data;
+
+    if (item->title == NULL || item->title->thumb_path == NULL || item->title->thumb_failed ||
+        item->jpg_info == NULL || item->jpg_info->image != NULL)
+    {
+        return;
+    }
+
+    if (item->jpg_info->decomp_handle != NULL)
+    {
+        jpeg_decoder_set_priority(item->jpg_info->decomp_handle, priority);
+        return;
+    }
+
+    if (thumbnail_show_cached(image_container))
+    {
+        return;
+    }
+
+    item->jpg_info->decomp_handle = jpeg_decoder_queue(item->title->thumb_path,
+                                                       jpg_decompression_complete_cb, item->jpg_info, priority);
+    if (item->jpg_info->decomp_handle != NULL)
+    {
+        jpeg_ll_value_t *n = _lv_ll_ins_tail(&jpeg_decomp_list);
+        n->image_container = image_container;
+    }
+}
+
+// Queue the thumbnails past the edge of the screen in the direction we are scrolling so they are
+// ready by the time they scroll into view.
+static void thumbnail_prefetch(parse_handle_t *p)
+{
+    const scroller_grid_t *g = &p->grid;
+    int focus_row = grid_row(g, p->focus_index);
+    int prefetch_rows = grid_rows_in(g, lv_obj_get_content_height(p->scroller)) + DASH_THUMBNAIL_PREFETCH_ROWS;
+
+    for (int r = 1; r <= prefetch_rows; r++)
+    {
+        int row = focus_row + r * scroll_direction;
+        for (int c = 0; c < g->cols; c++)
+        {
+            // Only items in view can be prefetched. The pool extends past the edge of the screen for this.
+            lv_obj_t *image_container = get_item(p, row * g->cols + c);
+            if (image_container == NULL)
+            {
+                continue;
+            }
+            int priority = thumbnail_get_priority(image_container);
+            if (priority >= 0)
+            {
+                thumbnail_request(image_container, priority);
+            }
+        }
+    }
 }
 
 static void update_thumbnail_callback(lv_event_t *event)
 {
     lv_obj_t *image_container = lv_event_get_target(event);
-    title_t *t = image_container->user_data;
+    scroller_item_t *item = image_container->user_data;
+
+    if (item->title == NULL || item->jpg_info == NULL || item->jpg_info->decomp_handle != NULL ||
+        item->jpg_info->image != NULL)
+    {
+        return;
+    }
+
+    int priority = thumbnail_get_priority(image_container);
+    if (priority >= 0)
+    {
+        thumbnail_request(image_container, priority);
+    }
+}
 
-    if (t->jpg_info == NULL)
+// Detach an item from its title so it can show another one
+static void item_unbind(lv_obj_t *item_container)
+{
+    scroller_item_t *item = item_container->user_data;
+    jpg_info_t *jpg_info = item->jpg_info;
+
+    if (item->title == NULL)
+    {
+        return;
+    }
+
+    if (jpg_info)
+    {
+        // The thumbnail stays in the memory cache for next time this title is shown
+        dash_thumbcache_mem_detach(&jpg_info->cache_user);
+        jpeg_decoder_free_image(jpg_info->preview_mem);
+        jpg_info->preview_mem = NULL;
+        jpg_info->image = NULL;
+        if (jpg_info->decomp_handle != NULL)
+        {
+            jpeg_ll_value_t *n;
+            _LV_LL_READ(&jpeg_decomp_list, n)
+            {
+                if (n->image_container == item_container)
+                {
+                    _lv_ll_remove(&jpeg_decomp_list, n);
+                    lv_mem_free(n);
+                    break;
+                }
+            }
+            // If a callback is already running it is blocked on the lvgl lock we hold. Leave jpg_info for it
+            // to free and start again with a new one.
+            if (jpeg_decoder_abort(jpg_info->decomp_handle) == false)
+            {
+                jpg_info->image_container = NULL;
+                item->jpg_info = jpg_info_create(item_container);
+            }
+            else
+            {
+                jpg_info->decomp_handle = NULL;
+            }
+        }
+    }
+
+    if (item->canvas)
+    {
+        lv_obj_add_flag(item->canvas, LV_OBJ_FLAG_HIDDEN);
+    }
+    item_set_focused(item_container, false);
+    lv_obj_add_flag(item_container, LV_OBJ_FLAG_HIDDEN);
+    item->index = -1;
+    item->title = NULL;
+}
+
+// Show the title at grid position index in an item
+static void item_bind(parse_handle_t *p, lv_obj_t *item_container, int index)
+{
+    scroller_item_t *item = item_container->user_data;
+    title_t *t = get_title(p, index);
+    const scroller_grid_t *g = &p->grid;
+
+    if (item->index == index && item->title == t)
+    {
+        return;
+    }
+    item_unbind(item_container);
+
+    item->index = index;
+    item->title = t;
+    lv_obj_set_pos(item_container, grid_col(g, index) * g->pitch_x, grid_get_y(g, index));
+    lv_label_set_text(item->label, t->title);
+    lv_obj_clear_flag(item_container, LV_OBJ_FLAG_HIDDEN);
+    if (index == p->focus_index && lv_obj_has_state(p->scroller, LV_STATE_FOCUSED))
+    {
+        item_set_focused(item_container, true);
+    }
+
+    // If the thumbnail is not in memory it is queued once the item is drawn
+    if (t->thumb_path != NULL && item->jpg_info != NULL)
+    {
+        thumbnail_show_cached(item_container);
+    }
+}
+
+// Bind the pooled items to the titles around the current scroll position. Items that have scrolled out of
+// range are reused for the titles coming into view.
+static void scroller_update_items(parse_handle_t *p)
+{
+    if (p->item_cnt == 0)
+    {
+        return;
+    }
+
+    const scroller_grid_t *g = &p->grid;
+    int top_row = LV_MAX(0, lv_obj_get_scroll_y(p->scroller)) / g->pitch_y;
+    int first = LV_MAX(0, top_row - DASH_THUMBNAIL_PREFETCH_ROWS) * g->cols;
+    int last = LV_MIN(p->title_cnt, first + p->item_cnt) - 1;
+
+    for (int i = 0; i < p->item_cnt; i++)
+    {
+        scroller_item_t *item = p->items[i]->user_data;
+        if (item->index < first || item->index > last)
+        {
+            item_unbind(p->items[i]);
+        }
+    }
+    for (int index = first; index <= last; index++)
+    {
+        item_bind(p, p->items[index % p->item_cnt], index);
+    }
+}
+
+static void scroll_anim_exec(void *var, int32_t v)
+{
+    lv_obj_scroll_to_y(var, v, LV_ANIM_OFF);
+}
+
+// Scroll a scroller to y. A scroller only ever has one scroll animation. If it is already moving, the running
+// animation is retargeted from where it is now, so a held key does not stack animations that fight each other.
+static void scroller_scroll_to_y(lv_obj_t *scroller, lv_coord_t y, lv_anim_enable_t anim)
+{
+    lv_coord_t now = lv_obj_get_scroll_y(scroller);
+    lv_anim_t *a = lv_anim_get(scroller, scroll_anim_exec);
+
+    if (anim == LV_ANIM_OFF)
+    {
+        if (a)
+        {
+            lv_anim_del(scroller, scroll_anim_exec);
+        }
+        lv_obj_scroll_to_y(scroller, y, LV_ANIM_OFF);
+        return;
+    }
+
+    if (a)
+    {
+        if (a->end_value != y)
+        {
+            a->start_value = now;
+            a->current_value = now;
+            a->end_value = y;
+            a->act_time = 0;
+        }
+        return;
+    }
+
+    if (now != y)
+    {
+        lv_anim_t scroll_anim;
+        lv_anim_init(&scroll_anim);
+        lv_anim_set_var(&scroll_anim, scroller);
+        lv_anim_set_exec_cb(&scroll_anim, scroll_anim_exec);
+        lv_anim_set_values(&scroll_anim, now, y);
+        lv_anim_set_time(&scroll_anim, DASH_SCROLL_ANIM_TIME);
+        lv_anim_set_path_cb(&scroll_anim, lv_anim_path_ease_out);
+        lv_anim_start(&scroll_anim);
+    }
+}
+
+// Scroll just enough to bring the title at grid position index into view
+static void scroller_scroll_to_index(parse_handle_t *p, int index, lv_anim_enable_t anim)
+{
+    const scroller_grid_t *g = &p->grid;
+    lv_coord_t y = grid_get_y(g, index);
+    lv_coord_t h = lv_obj_get_content_height(p->scroller);
+
+    // If the scroller is already moving, work from where it is going to end up
+    lv_anim_t *a = lv_anim_get(p->scroller, scroll_anim_exec);
+    lv_coord_t top = (a) ? a->end_value : lv_obj_get_scroll_y(p->scroller);
+
+    if (y < top)
+    {
+        scroller_scroll_to_y(p->scroller, y, anim);
+    }
+    else if (y + g->cell_h > top + h)
+    {
+        scroller_scroll_to_y(p->scroller, y + g->cell_h - h, anim);
+    }
+    else if (anim == LV_ANIM_OFF && a)
+    {
+        scroller_scroll_to_y(p->scroller, top, anim);
+    }
+}
+
+// Number of rows to move for an up, down or trigger press. Holding the key speeds it up.
+static int nav_get_rows(lv_key_t key, bool *held)
+{
+    static lv_key_t held_key;
+    static int repeats;
+
+    // lvgl keeps sending the key while it is held once it has been down for the long press time
+    lv_indev_t *indev = lv_indev_get_act();
+    *held = (indev != NULL && indev->proc.long_pr_sent && key == held_key);
+    repeats = (*held) ? (repeats + 1) : 0;
+    held_key = key;
+
+    int shift = LV_MIN(repeats / DASH_NAV_ACCEL_REPEATS, 8);
+    return LV_MIN(1 << shift, DASH_NAV_ACCEL_MAX_ROWS);
+}
+
+// The order the titles on a page are in. The recent page is always most recently launched first.
+static int page_get_sort_index(parse_handle_t *p)
+{
+    int sort_index = DASH_SORT_A_Z;
+    if (strcmp(p->page_title, "Recent") == 0)
+    {
+        return DASH_SORT_LAST_LAUNCH;
+    }
+    dash_scroller_get_sort_value(p->page_title, &sort_index);
+    return sort_index;
+}
+
+// Get the jump index bucket a title falls in for the sort order
+static void index_get_label(int sort_index, const title_t *t, char label[8])
+{
+    const char *date = (sort_index == DASH_SORT_LAST_LAUNCH) ? t->last_launch : t->release_date;
+
+    switch (sort_index)
+    {
+    case DASH_SORT_RATING:
+        lv_snprintf(label, 8, "%d", (int)t->rating);
+        break;
+    case DASH_SORT_LAST_LAUNCH:
+    case DASH_SORT_RELEASE_DATE:
+        // Dates are ISO 8601 so the year is the first four characters. Titles never launched have no date.
+        if (strlen(date) >= 4 && date[0] != '0')
+        {
+            lv_memcpy(label, date, 4);
+            label[4] = '\0';
+        }
+        else
+        {
+            strcpy(label, "-");
+        }
+        break;
+    default:
+        label[0] = (isalpha((unsigned char)t->title[0])) ? toupper((unsigned char)t->title[0]) : '#';
+        label[1] = '\0';
+    }
+}
+
+// Build the jump index for a page. The titles are in sorted order so each bucket is one run of grid positions.
+static void scroller_build_index(parse_handle_t *p)
+{
+    int sort_index = page_get_sort_index(p);
+    char label[8];
+    char prev[8] = "";
+    int bucket_cnt = 0;
+
+    lv_mem_free(p->buckets);
+    p->buckets = NULL;
+    p->bucket_cnt = 0;
+
+    for (int i = 0; i < p->title_cnt; i++)
+    {
+        index_get_label(sort_index, get_title(p, i), label);
+        if (i == 0 || strcmp(label, prev) != 0)
+        {
+            strcpy(prev, label);
+            bucket_cnt++;
+        }
+    }
+    if (bucket_cnt == 0)
+    {
+        return;
+    }
+
+    p->buckets = lv_mem_alloc(sizeof(scroller_bucket_t) * bucket_cnt);
+    assert(p->buckets);
+    for (int i = 0; i < p->title_cnt; i++)
+    {
+        index_get_label(sort_index, get_title(p, i), label);
+        if (i == 0 || strcmp(label, p->buckets[p->bucket_cnt - 1].label) != 0)
+        {
+            strcpy(p->buckets[p->bucket_cnt].label, label);
+            p->buckets[p->bucket_cnt].index = i;
+            p->bucket_cnt++;
+        }
+    }
+}
+
+// Get the bucket the title at grid position index is in
+static int index_find_bucket(parse_handle_t *p, int index)
+{
+    int lo = 0, hi = p->bucket_cnt - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (p->buckets[mid].index <= index)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// Show the jump overlay with the bucket the selection is in highlighted
+static void jump_overlay_update(parse_handle_t *p)
+{
+    int current = index_find_bucket(p, p->focus_index);
+    char text[512];
+    int len = 0;
+
+    text[0] = '\0';
+    for (int i = 0; i < p->bucket_cnt && len < (int)sizeof(text) - 32; i++)
+    {
+        if (i == current)
+        {
+            len += lv_snprintf(&text[len], sizeof(text) - len, " %s ", p->buckets[i].label);
+        }
+        else
+        {
+            len += lv_snprintf(&text[len], sizeof(text) - len, " %s %s# ", DASH_MENU_COLOR, p->buckets[i].label);
+        }
+    }
+    lv_label_set_text(label_jump, text);
+    lv_obj_clear_flag(label_jump, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(label_jump);
+}
+
+static void jump_overlay_close(void)
+{
+    lv_obj_add_flag(label_jump, LV_OBJ_FLAG_HIDDEN);
+}
+
+// Move the selection straight to the first title of another bucket. No animation so the rows in between are
+// never laid out or drawn.
+static void jump_to_bucket(parse_handle_t *p, int bucket)
+{
+    bucket = LV_CLAMP(0, bucket, p->bucket_cnt - 1);
+    scroll_direction = (p->buckets[bucket].index >= p->focus_index) ? 1 : -1;
+    scroller_set_focus(p, p->buckets[bucket].index);
+    scroller_scroll_to_index(p, p->focus_index, LV_ANIM_OFF);
+    thumbnail_prefetch(p);
+    jump_overlay_update(p);
+}
+
+// Replace the titles on a page. Takes ownership of titles and order. Must be called with the lvgl lock held.
+static void scroller_set_titles(parse_handle_t *p, title_t *titles, int *order, int title_cnt)
+{
+    // Keep the same title selected if it is still on the page. A released page has no titles, so the
+    // id saved before it was released is used instead.
+    if (p->title_cnt > 0)
+    {
+        p->focus_id = get_title(p, p->focus_index)->db_id;
+    }
+
+    for (int i = 0; i < p->item_cnt; i++)
+    {
+        item_unbind(p->items[i]);
+    }
+    for (int i = 0; i < p->title_cnt; i++)
     {
-        return;
+        lv_mem_free(p->titles[i].thumb_path);
+    }
+    lv_mem_free(p->titles);
+    lv_mem_free(p->order);
+
+    p->titles = titles;
+    p->order = order;
+    p->title_cnt = title_cnt;
+    p->title_generation++;
+    p->focus_index = LV_CLAMP(0, p->focus_index, LV_MAX(0, title_cnt - 1));
+    for (int i = 0; i < title_cnt && p->focus_id >= 0; i++)
+    {
+        if (get_title(p, i)->db_id == p->focus_id)
+        {
+            p->focus_index = i;
+            break;
+        }
     }
+    scroller_build_index(p);
 
-    if (t->jpg_info->decomp_handle == NULL && t->jpg_info->mem == NULL)
+    lv_obj_invalidate(p->scroller);
+    scroller_update_items(p);
+    if (title_cnt > 0)
     {
-        t->jpg_info->decomp_handle = jpeg_decoder_queue(t->jpg_info->thumb_path,
-                                                        jpg_decompression_complete_cb, image_container);
-        jpeg_ll_value_t *n = _lv_ll_ins_tail(&jpeg_decomp_list);
-        n->image_container = image_container;
+        // Bring back the selection the page had before it was released
+        scroller_scroll_to_index(p, p->focus_index, LV_ANIM_OFF);
+    }
+    if (lv_obj_has_state(p->scroller, LV_STATE_FOCUSED))
+    {
+        scroller_show_focus(p);
     }
 }
 
@@ -107,36 +819,69 @@ static int get_launch_path_callback(void *param, int argc, char **argv, char **a
     return 0;
 }
 
-static void item_selection_callback(lv_event_t *event)
+static void scroller_event_callback(lv_event_t *event)
 {
     lv_event_code_t e = lv_event_get_code(event);
+    lv_obj_t *scroller = lv_event_get_target(event);
+    parse_handle_t *p = scroller->user_data;
 
-    lv_obj_t *item_container = lv_event_get_target(event);
-    title_t *t = item_container->user_data;
-    if (e == LV_EVENT_FOCUSED || e == LV_EVENT_DEFOCUSED)
+    if (e == LV_EVENT_FOCUSED)
     {
-        lv_style_value_t border_width;
-        lv_style_value_t border_colour;
-        lv_style_get_prop(&titleview_image_container_style, LV_STYLE_BORDER_WIDTH, &border_width);
-        lv_style_get_prop(&titleview_image_container_style, LV_STYLE_BORDER_COLOR, &border_colour);
-        if (e == LV_EVENT_FOCUSED)
-        {
-            lv_obj_set_style_border_width(item_container, border_width.num * 2, LV_PART_MAIN);
-            lv_obj_set_style_border_color(item_container, lv_color_white(), LV_PART_MAIN);
-            lv_label_set_text(label_footer, t->title);
-        }
-        else
+        scroller_show_focus(p);
+    }
+    else if (e == LV_EVENT_DEFOCUSED)
+    {
+        jump_overlay_close();
+        lv_obj_t *item_container = get_item(p, p->focus_index);
+        if (item_container)
         {
-            lv_obj_set_style_border_width(item_container, border_width.num, LV_PART_MAIN);
-            lv_obj_set_style_border_color(item_container, border_colour.color, LV_PART_MAIN);
+            item_set_focused(item_container, false);
         }
     }
+    else if (e == LV_EVENT_SCROLL)
+    {
+        scroller_update_items(p);
+    }
+    else if (e == LV_EVENT_GET_SELF_SIZE)
+    {
+        // There are only items for the titles in view, so report the size of the whole grid for scrolling
+        lv_point_t *size = lv_event_get_param(event);
+        size->y = LV_MAX(size->y, grid_get_height(&p->grid, p->title_cnt));
+    }
     else if (e == LV_EVENT_KEY)
     {
-        lv_obj_t *scroller = lv_obj_get_parent(item_container);
-        int *current_index = (int *)&scroller->user_data;
-
         lv_key_t key = *((lv_key_t *)lv_event_get_param(event));
+
+        // While the jump overlay is open the directions move between buckets. Anything else closes it.
+        if (lv_obj_has_flag(label_jump, LV_OBJ_FLAG_HIDDEN) == false)
+        {
+            int bucket = index_find_bucket(p, p->focus_index);
+            if (p->bucket_cnt > 0 && (key == LV_KEY_RIGHT || key == LV_KEY_DOWN || key == 'R'))
+            {
+                jump_to_bucket(p, bucket + 1);
+                return;
+            }
+            else if (p->bucket_cnt > 0 && (key == LV_KEY_LEFT || key == LV_KEY_UP || key == 'L'))
+            {
+                // Go back to the start of this bucket first, like a track skip
+                jump_to_bucket(p, (p->focus_index > p->buckets[bucket].index) ? bucket : bucket - 1);
+                return;
+            }
+            jump_overlay_close();
+            if (key == DASH_JUMP_INDEX || key == LV_KEY_ENTER || key == LV_KEY_ESC)
+            {
+                return;
+            }
+        }
+        else if (key == DASH_JUMP_INDEX)
+        {
+            if (p->bucket_cnt > 0)
+            {
+                jump_overlay_update(p);
+            }
+            return;
+        }
+
         if (key == DASH_PREV_PAGE || key == DASH_NEXT_PAGE)
         {
             page_current += (key == DASH_NEXT_PAGE) ? (1) : -1;
@@ -145,21 +890,27 @@ static void item_selection_callback(lv_event_t *event)
         // L and R are the back triggers
         else if (key == LV_KEY_RIGHT || key == LV_KEY_LEFT || key == LV_KEY_UP || key == LV_KEY_DOWN || key == 'L' || key == 'R')
         {
-            int last_index = lv_obj_get_child_cnt(scroller) - 1;
-            int new_index = *current_index;
+            int last_index = p->title_cnt - 1;
+            int new_index = p->focus_index;
+            bool held;
+            int cols = p->grid.cols * nav_get_rows(key, &held);
+
+            if (p->title_cnt == 0)
+            {
+                return;
+            }
 
-            // FIXME: Should really allow thumbnails of any width
-            int tiles_per_row = lv_obj_get_width(scroller) / DASH_THUMBNAIL_WIDTH;
+            scroll_direction = (key == LV_KEY_UP || key == LV_KEY_LEFT || key == 'L') ? -1 : 1;
 
-            // At the start, loop to end
-            if (*current_index <= 1 && key == LV_KEY_UP)
+            // At the start, loop to end. Only on a fresh press so holding the key stops at the end.
+            if (p->focus_index == 0 && key == LV_KEY_UP && held == false)
             {
                 new_index = last_index;
             }
             // At the end, loop to start
-            else if (*current_index == last_index && key == LV_KEY_DOWN)
+            else if (p->focus_index == last_index && key == LV_KEY_DOWN && held == false)
             {
-                new_index = 1;
+                new_index = 0;
             }
             // Increment left or right one
             else if (key == LV_KEY_RIGHT || key == LV_KEY_LEFT)
@@ -169,50 +920,38 @@ static void item_selection_callback(lv_event_t *event)
             // Increment up or down one
             else if (key == LV_KEY_UP || key == LV_KEY_DOWN)
             {
-                if (new_index == 0)
-                {
-                    new_index = 1;
-                }
-                else
-                {
-                    new_index += (key == LV_KEY_DOWN) ? tiles_per_row : -tiles_per_row;
-                }
+                new_index += (key == LV_KEY_DOWN) ? cols : -cols;
             }
             // Increment up or down lots (LT and RT)
             else if (key == 'L' || key == 'R')
             {
-                new_index += (key == 'R') ? (tiles_per_row * 8) : -(tiles_per_row * 8);
+                new_index += (key == 'R') ? (cols * 8) : -(cols * 8);
             }
-            // Clamp the new index within the limits. Prefer index 1 as index 0 is the null
-            // item. But will revert to 0 if no items in page
-            new_index = LV_MAX(1, new_index);
             new_index = LV_CLAMP(0, new_index, last_index);
-            *current_index = new_index;
 
-            lv_obj_t *new_item_container = lv_obj_get_child(scroller, new_index);
-            assert(lv_obj_is_valid(new_item_container));
-
-            // Scroll until our new selection is in view
-            lv_obj_scroll_to_view_recursive(new_item_container, LV_ANIM_ON);
-            dash_focus_change(new_item_container);
+            // Scroll until our new selection is in view. The items are rebound as it scrolls.
+            scroller_set_focus(p, new_index);
+            scroller_scroll_to_index(p, new_index, LV_ANIM_ON);
+            thumbnail_prefetch(p);
         }
-        else if (key == DASH_INFO_PAGE && *current_index != 0)
+        else if (key == DASH_INFO_PAGE && p->title_cnt > 0)
         {
-            dash_synop_open((t->db_id));
+            dash_synop_open(get_title(p, p->focus_index)->db_id);
         }
         else if (key == DASH_SETTINGS_PAGE)
         {
             dash_mainmenu_open();
         }
-        else if (key == LV_KEY_ENTER && *current_index > 0)
+        else if (key == LV_KEY_ENTER && p->title_cnt > 0)
         {
             char cmd[SQL_MAX_COMMAND_LEN];
             char time_str[20];
-            lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_LAUNCH_PATH, t->db_id);
+            int db_id = get_title(p, p->focus_index)->db_id;
+            lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_LAUNCH_PATH, db_id);
             db_command_with_callback(cmd, get_launch_path_callback, NULL);
 
             platform_get_iso8601_time(time_str);
-            lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_SET_LAST_LAUNCH_DATETIME, time_str, t->db_id);
+            lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_SET_LAST_LAUNCH_DATETIME, time_str, db_id);
             db_command_with_callback(cmd, NULL, NULL);
 
             lv_set_quit(LV_QUIT_OTHER);
@@ -220,26 +959,68 @@ static void item_selection_callback(lv_event_t *event)
     }
 }
 
+static void scroller_deletion_callback(lv_event_t *event)
+{
+    lv_obj_t *scroller = lv_event_get_target(event);
+    parse_handle_t *p = scroller->user_data;
+
+    // The items are deleted after this. They are unbound now while the titles are still valid.
+    scroller_set_titles(p, NULL, NULL, 0);
+    lv_mem_free(p->items);
+    p->items = NULL;
+    p->item_cnt = 0;
+}
+
 static void item_deletion_callback(lv_event_t *event)
 {
     lv_obj_t *item_container = lv_event_get_target(event);
-    title_t *t = item_container->user_data;
-    if (t->jpg_info)
-    {
-        lv_lru_remove(thumbnail_cache, t, sizeof(title_t *));
-        t->jpg_info->decomp_handle = NULL;
-        lv_mem_free(t->jpg_info->thumb_path);
-        lv_mem_free(t->jpg_info);
-        lv_mem_free(t);
-    }
+    scroller_item_t *item = item_container->user_data;
+    item_unbind(item_container);
+    lv_mem_free(item->jpg_info);
+    lv_mem_free(item);
 }
 
+static lv_obj_t *item_create(lv_obj_t *scroller)
+{
+    parse_handle_t *p = scroller->user_data;
+    scroller_item_t *item = lv_mem_alloc(sizeof(scroller_item_t));
+    assert(item);
+    lv_memset(item, 0, sizeof(scroller_item_t));
+    item->index = -1;
+
+    lv_obj_t *item_container = lv_obj_create(scroller);
+    item_container->user_data = item;
+    lv_obj_add_style(item_container, &titleview_image_container_style, LV_PART_MAIN);
+    lv_obj_add_style(item_container, &titleview_image_container_focused_style, LV_PART_MAIN | LV_STATE_FOCUSED);
+    lv_obj_clear_flag(item_container, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(item_container, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_size(item_container, p->grid.cell_w, p->grid.cell_h);
+
+    // Create a label for the game title
+    item->label = lv_label_create(item_container);
+    lv_obj_add_style(item->label, &titleview_image_text_style, LV_PART_MAIN);
+    lv_obj_set_width(item->label, p->grid.cell_w);
+    lv_obj_update_layout(item->label);
+    lv_label_set_long_mode(item->label, LV_LABEL_LONG_WRAP);
+
+    item->jpg_info = jpg_info_create(item_container);
+    lv_obj_add_event_cb(item_container, update_thumbnail_callback, LV_EVENT_DRAW_MAIN_END, NULL);
+    lv_obj_add_event_cb(item_container, item_deletion_callback, LV_EVENT_DELETE, NULL);
+    return item_container;
+}
+
+// The columns read for each title when a page is scanned
+#define SQL_TITLE_SCAN_COLUMNS SQL_TITLE_DB_ID "," SQL_TITLE_NAME "," SQL_TITLE_LAUNCH_PATH "," \
+                               SQL_TITLE_RATING "," SQL_TITLE_RELEASE_DATE "," SQL_TITLE_LAST_LAUNCH
+
 typedef struct item_strings
 {
     char id[8];
     char title[MAX_META_LEN];
     char *launch_path;
-    lv_obj_t *item_container;
+    float rating;
+    char release_date[16];
+    char last_launch[20];
     struct item_strings *next;
 } item_strings_t;
 
@@ -247,6 +1028,7 @@ typedef struct item_strings_callback
 {
     item_strings_t *head;
     item_strings_t *tail;
+    int count;
 } item_strings_callback_t;
 
 // Callback when a new row is read from the SQL database. This is a new item to add
@@ -270,13 +1052,20 @@ static int item_scan_callback(void *param, int argc, char **argv, char **azColNa
         item_cb->tail->next = item;
         item_cb->tail = item;
     }
+    item_cb->count++;
 
     assert(strcmp(azColName[0], SQL_TITLE_DB_ID) == 0);
     assert(strcmp(azColName[1], SQL_TITLE_NAME) == 0);
     assert(strcmp(azColName[2], SQL_TITLE_LAUNCH_PATH) == 0);
+    assert(strcmp(azColName[3], SQL_TITLE_RATING) == 0);
+    assert(strcmp(azColName[4], SQL_TITLE_RELEASE_DATE) == 0);
+    assert(strcmp(azColName[5], SQL_TITLE_LAST_LAUNCH) == 0);
 
     strncpy(item->id, argv[0], sizeof(item->id) - 1);
     strncpy(item->title, argv[1], sizeof(item->title) - 1);
+    item->rating = (argv[3]) ? atof(argv[3]) : 0.0f;
+    strncpy(item->release_date, (argv[4]) ? argv[4] : "", sizeof(item->release_date) - 1);
+    strncpy(item->last_launch, (argv[5]) ? argv[5] : "", sizeof(item->last_launch) - 1);
 
     int launch_path_len = strlen(argv[2]) + 1;
     item->launch_path = lv_mem_alloc(launch_path_len);
@@ -284,87 +1073,155 @@ static int item_scan_callback(void *param, int argc, char **argv, char **azColNa
     return 0;
 }
 
-static void item_scan_add(lv_obj_t *scroller, item_strings_callback_t *item_cb)
+static int title_id_compare(const void *a, const void *b)
 {
-    item_strings_t *item = item_cb->head;
-    // First we add all the items to lvgl so they display quickly
-    while (item)
+    const title_t *ta = *(const title_t **)a;
+    const title_t *tb = *(const title_t **)b;
+    return (ta->db_id > tb->db_id) - (ta->db_id < tb->db_id);
+}
+
+// When a page is read again after a rescan, titles that were already on it take over their old thumbnail so
+// the art stays on screen. It is only looked up again if the file has changed.
+static void scroller_carry_thumbnails(parse_handle_t *p, title_t *titles, int title_cnt)
+{
+    if (p->title_cnt == 0 || title_cnt == 0)
+    {
+        return;
+    }
+
+    title_t **by_id = lv_mem_alloc(sizeof(title_t *) * p->title_cnt);
+    if (by_id == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < p->title_cnt; i++)
     {
-        title_t *t = lv_mem_alloc(sizeof(title_t));
-        assert(t);
-        if (t == NULL)
+        by_id[i] = &p->titles[i];
+    }
+    qsort(by_id, p->title_cnt, sizeof(title_t *), title_id_compare);
+
+    for (int i = 0; i < title_cnt; i++)
+    {
+        title_t *key = &titles[i];
+        title_t **old = bsearch(&key, by_id, p->title_cnt, sizeof(title_t *), title_id_compare);
+        if (old == NULL || (*old)->thumb_path == NULL)
         {
             continue;
         }
-        t->jpg_info = NULL;
-        t->title[0] = '\0';
-        t->db_id = atoi(item->id);
+        titles[i].thumb_path = (*old)->thumb_path;
+        titles[i].file_size = (*old)->file_size;
+        titles[i].write_time = (*old)->write_time;
+        titles[i].thumb_failed = (*old)->thumb_failed;
+        (*old)->thumb_path = NULL;
+    }
+    lv_mem_free(by_id);
+}
 
-        lvgl_getlock();
-        lv_obj_t *item_container = lv_obj_create(scroller);
-        item->item_container = item_container;
-        item_container->user_data = t;
-        lv_obj_add_style(item_container, &titleview_image_container_style, LV_PART_MAIN);
-        lv_obj_clear_flag(item_container, LV_OBJ_FLAG_SCROLLABLE);
-        lv_obj_set_height(item_container, DASH_THUMBNAIL_HEIGHT);
-        lv_obj_set_width(item_container, DASH_THUMBNAIL_WIDTH);
-
-        // Create a label with the game title
-        lv_obj_t *label = lv_label_create(item_container);
-        lv_obj_add_style(label, &titleview_image_text_style, LV_PART_MAIN);
-        lv_obj_set_width(label, DASH_THUMBNAIL_WIDTH);
-        lv_obj_update_layout(label);
-        lv_label_set_text(label, item->title);
-        lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
-
-        lv_group_add_obj(lv_group_get_default(), item_container);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_KEY, NULL);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_FOCUSED, NULL);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_DEFOCUSED, NULL);
-        lv_obj_add_event_cb(item_container, item_deletion_callback, LV_EVENT_DELETE, NULL);
-
-        strncpy(t->title, item->title, sizeof(t->title) - 1);
-        lvgl_removelock();
-        item = item->next;
+static void item_scan_add(parse_handle_t *p, item_strings_callback_t *item_cb)
+{
+    item_strings_t *item = item_cb->head;
+    title_t *titles = NULL;
+    int *order = NULL;
+
+    // First we add all the titles so they display quickly
+    if (item_cb->count > 0)
+    {
+        titles = lv_mem_alloc(sizeof(title_t) * item_cb->count);
+        order = lv_mem_alloc(sizeof(int) * item_cb->count);
+        assert(titles && order);
+        if (titles == NULL || order == NULL)
+        {
+            lv_mem_free(titles);
+            lv_mem_free(order);
+            return;
+        }
+    }
+    for (int i = 0; item; i++, item = item->next)
+    {
+        lv_memset(&titles[i], 0, sizeof(title_t));
+        titles[i].db_id = atoi(item->id);
+        strncpy(titles[i].title, item->title, sizeof(titles[i].title) - 1);
+        titles[i].rating = item->rating;
+        strcpy(titles[i].release_date, item->release_date);
+        strcpy(titles[i].last_launch, item->last_launch);
+        order[i] = i;
     }
 
+    lvgl_getlock();
+    scroller_carry_thumbnails(p, titles, item_cb->count);
+    scroller_set_titles(p, titles, order, item_cb->count);
+    int generation = p->title_generation;
+    lvgl_removelock();
+
     // Next we scan for thumbnails
     item = item_cb->head;
-    while (item)
+    for (int i = 0; item; i++, item = item->next)
     {
-        lv_obj_t *item_container = item->item_container;
-        title_t *t = item_container->user_data;
-
         // Check if a thumbnail exists
         char *thumb_path = item->launch_path;
         size_t len = strlen(thumb_path);
+        uint32_t file_size;
+        uint64_t write_time;
         assert(len > 3);
         strcpy(&thumb_path[len - 3], "tbn");
-        DWORD fileAttributes = GetFileAttributes(thumb_path);
-        if (fileAttributes == INVALID_FILE_ATTRIBUTES || (fileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        bool found = dash_thumbcache_get_version(thumb_path, &file_size, &write_time);
+
+        lvgl_getlock();
+        // Stop if the page was cleared or rescanned while we were looking
+        if (p->title_generation != generation)
         {
-            lv_mem_free(thumb_path);
-            item = item->next;
-            continue;
+            lvgl_removelock();
+            break;
         }
 
-        jpg_info_t *jpg_info = lv_mem_alloc(sizeof(jpg_info_t));
-        assert(jpg_info);
-        if (jpg_info == NULL)
+        // Nothing to do if there is still no thumbnail, or the one carried over from before a rescan is current
+        title_t *t = &titles[i];
+        if ((found == false && t->thumb_path == NULL) ||
+            (found && t->thumb_path && t->file_size == file_size && t->write_time == write_time))
         {
-            lv_mem_free(thumb_path);
-            item = item->next;
+            lvgl_removelock();
             continue;
         }
-        lv_memset(jpg_info, 0, sizeof(jpg_info_t));
-        jpg_info->thumb_path = thumb_path;
 
-        lvgl_getlock();
-        t->jpg_info = jpg_info;
-        lv_obj_add_event_cb(item_container, update_thumbnail_callback, LV_EVENT_DRAW_MAIN_END, NULL);
-        lv_obj_invalidate(item_container);
+        // Items still showing an old thumbnail let go of it first. They are bound again below.
+        bool rebind = false;
+        for (int j = 0; j < p->item_cnt && t->thumb_path; j++)
+        {
+            scroller_item_t *scroller_item = p->items[j]->user_data;
+            if (scroller_item->title == t)
+            {
+                item_unbind(p->items[j]);
+                rebind = true;
+            }
+        }
+        lv_mem_free(t->thumb_path);
+        t->thumb_path = NULL;
+        t->thumb_failed = false;
+        if (found)
+        {
+            t->thumb_path = thumb_path;
+            t->file_size = file_size;
+            t->write_time = write_time;
+            item->launch_path = NULL;
+        }
+
+        if (rebind)
+        {
+            scroller_update_items(p);
+        }
+        else
+        {
+            // If the title is already on screen, redraw it so its thumbnail is requested
+            for (int j = 0; j < p->item_cnt; j++)
+            {
+                scroller_item_t *scroller_item = p->items[j]->user_data;
+                if (scroller_item->title == t)
+                {
+                    lv_obj_invalidate(p->items[j]);
+                }
+            }
+        }
         lvgl_removelock();
-        item = item->next;
     }
 }
 
@@ -402,11 +1259,11 @@ static int db_scan_thread_f(void *param)
     if (strcmp(p->page_title, "Recent") == 0)
     {
         lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_RECENT,
-                        SQL_TITLE_DB_ID "," SQL_TITLE_NAME "," SQL_TITLE_LAUNCH_PATH,
+                        SQL_TITLE_SCAN_COLUMNS,
                         dash_settings.earliest_recent_date, dash_settings.max_recent_items);
 
         db_command_with_callback(cmd, item_scan_callback, &item_cb);
-        item_scan_add(p->scroller, &item_cb);
+        item_scan_add(p, &item_cb);
     }
     else
     {
@@ -416,55 +1273,106 @@ static int db_scan_thread_f(void *param)
         dash_scroller_get_sort_value(p->page_title, &sort_index);
         dash_scroller_get_sort_strings(sort_index, &sort_by, &order_by);
 
-        lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_SORTED_LIST,
-                            SQL_TITLE_DB_ID "," SQL_TITLE_NAME "," SQL_TITLE_LAUNCH_PATH,
+        lv_snprintf(cmd, sizeof(cmd), (p->collection) ? SQL_TITLE_GET_SORTED_COLLECTION : SQL_TITLE_GET_SORTED_LIST,
+                            SQL_TITLE_SCAN_COLUMNS,
                             p->page_title, sort_by, order_by);
 
         db_command_with_callback(cmd, item_scan_callback, &item_cb);
-        item_scan_add(p->scroller, &item_cb);
+        item_scan_add(p, &item_cb);
     }
 
+    // Any launch paths not taken as thumbnail paths are freed here
     while (item_cb.head)
     {
         item_strings_t *next_item = item_cb.head->next;
+        lv_mem_free(item_cb.head->launch_path);
         lv_mem_free(item_cb.head);
         item_cb.head = next_item;
     }
-    return 0;
-}
 
-static void cache_free(title_t *t)
-{
-    assert(lv_obj_is_valid(t->jpg_info->canvas));
-    jpeg_decoder_abort(t->jpg_info->decomp_handle);
-    assert(t->jpg_info->mem);
-    free(t->jpg_info->mem);
-    lv_obj_del(t->jpg_info->canvas);
-    t->jpg_info->decomp_handle = NULL;
-    t->jpg_info->mem = NULL;
-    t->jpg_info->image = NULL;
+    lvgl_getlock();
+    p->scanning = false;
+    lvgl_removelock();
+    return 0;
 }
 
 void dash_scroller_clear_page(const char *page_title)
 {
-    lv_obj_t *scroller = NULL;
     for (int i = 0; i < DASH_MAX_PAGES; i++)
     {
         if (parsers[i] == NULL)
         {
             continue;
         }
-        if (strcmp(page_title, parsers[i]->page_title) == 0)
+        if (strcmp(page_title, parsers[i]->page_title) == 0 && parsers[i]->scroller != NULL)
         {
-            scroller = parsers[i]->scroller;
-            lv_obj_t *item_container = lv_obj_get_child(scroller, 1);
-            while (item_container)
+            scroller_set_titles(parsers[i], NULL, NULL, 0);
+            parsers[i]->focus_id = -1;
+            scroller_scroll_to_y(parsers[i]->scroller, 0, LV_ANIM_OFF);
+        }
+    }
+}
+
+static int id_compare(const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+    return (ia > ib) - (ia < ib);
+}
+
+// Mark the built pages that a database rescan changed so they are read again. Pages that are not built read
+// the database fresh when they are. A change_cnt of -1 marks every built page. Must be called with the lvgl lock
+// held.
+void dash_scroller_apply_changes(const db_change_t *changes, int change_cnt)
+{
+    if (change_cnt == 0)
+    {
+        return;
+    }
+
+    // Without a full list of what changed every page is read again
+    int *ids = (change_cnt > 0) ? lv_mem_alloc(sizeof(int) * change_cnt) : NULL;
+    if (ids == NULL)
+    {
+        for (int i = 0; i < DASH_MAX_PAGES; i++)
+        {
+            if (parsers[i] && parsers[i]->scroller)
             {
-                lv_obj_del(item_container);
-                item_container = lv_obj_get_child(scroller, 1);
+                parsers[i]->rescan_pending = true;
             }
         }
+        return;
+    }
+    for (int i = 0; i < change_cnt; i++)
+    {
+        ids[i] = changes[i].db_id;
+    }
+    qsort(ids, change_cnt, sizeof(int), id_compare);
+
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        parse_handle_t *p = parsers[i];
+        if (p == NULL || p->scroller == NULL)
+        {
+            continue;
+        }
+
+        // Any change can move a title in or out of a collection. The triggers have already worked out which.
+        bool changed = p->collection;
+
+        // Titles that were added to or moved to this page
+        for (int j = 0; j < change_cnt && changed == false; j++)
+        {
+            changed = (changes[j].op != SQLITE_DELETE && strcmp(changes[j].page, p->page_title) == 0);
+        }
+
+        // Titles on this page that were changed, moved away or deleted
+        for (int j = 0; j < p->title_cnt && changed == false; j++)
+        {
+            changed = (bsearch(&p->titles[j].db_id, ids, change_cnt, sizeof(int), id_compare) != NULL);
+        }
+        p->rescan_pending |= changed;
     }
+    lv_mem_free(ids);
 }
 
 static void jpeg_clear_timer(lv_timer_t *t)
@@ -474,16 +1382,29 @@ static void jpeg_clear_timer(lv_timer_t *t)
     while (item)
     {
         lv_obj_t *image_container = item->image_container;
-        title_t *title = image_container->user_data;
-        assert(title->jpg_info);
-        // Still decompressing but no longer visible. Lets abort it.
-        if (lv_obj_is_visible(image_container) == false)
+        scroller_item_t *scroller_item = image_container->user_data;
+        jpg_info_t *jpg_info = scroller_item->jpg_info;
+        assert(jpg_info && scroller_item->title);
+        if (jpg_info->decomp_handle != NULL)
         {
-            jpeg_decoder_abort(title->jpg_info->decomp_handle);
-            title->jpg_info->decomp_handle = NULL;
+            // Re-rank the job as the focus moves. Once it is off screen and not being prefetched, abort it.
+            int priority = thumbnail_get_priority(image_container);
+            // If a callback is already running the handle is kept, so the item knows it is still in use. The next
+            // pass aborts it again once the callback is done.
+            if (priority < 0)
+            {
+                if (jpeg_decoder_abort(jpg_info->decomp_handle))
+                {
+                    jpg_info->decomp_handle = NULL;
+                }
+            }
+            else
+            {
+                jpeg_decoder_set_priority(jpg_info->decomp_handle, priority);
+            }
         }
         // Jpeg finished decomp (or was aborted already), dont need to it anymore
-        if (title->jpg_info->decomp_handle == NULL)
+        if (jpg_info->decomp_handle == NULL)
         {
             _lv_ll_remove(&jpeg_decomp_list, item);
             lv_mem_free(item);
@@ -497,6 +1418,187 @@ static void jpeg_clear_timer(lv_timer_t *t)
     }
 }
 
+// Create the scroller for a page and start reading its titles from the database
+// Start a thread that starts reading the database for items on this page.
+// Thread needs to have a mutex on the database and lvgl
+static void page_scan(parse_handle_t *parser)
+{
+    // The last scan has finished but its thread still needs cleaning up
+    if (parser->db_scan_thread != NULL)
+    {
+        SDL_WaitThread(parser->db_scan_thread, NULL);
+        parser->db_scan_thread = NULL;
+    }
+    parser->rescan_pending = false;
+    parser->scanning = true;
+    parser->db_scan_thread = SDL_CreateThread(db_scan_thread_f, "game_parser_thread", parser);
+}
+
+static void page_build(parse_handle_t *parser)
+{
+    lv_obj_t **scroller = &parser->scroller;
+
+    if (parser->scroller != NULL)
+    {
+        return;
+    }
+
+    // Create a container that will have our scroller game art
+    *scroller = lv_obj_create(parser->tile);
+    (*scroller)->user_data = parser;
+    lv_obj_t *label_page_title = lv_obj_get_child(parser->tile, 0); // Created with the tile
+
+    // Setup the container for our scrolling game art
+    int sc_parent_w = lv_obj_get_width(lv_obj_get_parent(*scroller));
+    int sc_parent_h = lv_obj_get_height(lv_obj_get_parent(*scroller));
+    // Make the width exactly equal to the highest number of thumbnails that can fit
+    int sc_w = sc_parent_w - (sc_parent_w % DASH_THUMBNAIL_WIDTH);
+    int sc_h = sc_parent_h - lv_obj_get_height(label_page_title) - lv_obj_get_height(label_footer);
+    lv_obj_add_style(*scroller, &titleview_style, LV_PART_MAIN);
+    lv_obj_align(*scroller, LV_ALIGN_TOP_MID, 0, lv_obj_get_height(label_page_title));
+    lv_obj_set_width(*scroller, sc_w);
+    lv_obj_set_height(*scroller, sc_h);
+    lv_obj_update_layout(*scroller);
+    grid_init(parser);
+
+    // The scroller takes the input focus for the page and handles the keys itself. It highlights the
+    // selected item instead of showing its own focus outline.
+    lv_obj_clear_flag(*scroller, LV_OBJ_FLAG_SCROLL_WITH_ARROW);
+    lv_obj_set_style_outline_width(*scroller, 0, LV_PART_MAIN | LV_STATE_FOCUS_KEY);
+    lv_group_add_obj(lv_group_get_default(), *scroller);
+    lv_obj_add_event_cb(*scroller, scroller_event_callback, LV_EVENT_KEY, NULL);
+    lv_obj_add_event_cb(*scroller, scroller_event_callback, LV_EVENT_FOCUSED, NULL);
+    lv_obj_add_event_cb(*scroller, scroller_event_callback, LV_EVENT_DEFOCUSED, NULL);
+    lv_obj_add_event_cb(*scroller, scroller_event_callback, LV_EVENT_SCROLL, NULL);
+    lv_obj_add_event_cb(*scroller, scroller_event_callback, LV_EVENT_GET_SELF_SIZE, NULL);
+    lv_obj_add_event_cb(*scroller, scroller_deletion_callback, LV_EVENT_DELETE, NULL);
+
+    // Create enough items to fill the screen, plus the rows past each edge that are prefetched. These are
+    // reused for every title on the page so the number of objects does not depend on the number of titles.
+    int item_rows = grid_rows_in(&parser->grid, sc_h) + 1 + 2 * DASH_THUMBNAIL_PREFETCH_ROWS;
+    parser->item_cnt = parser->grid.cols * item_rows;
+    parser->items = lv_mem_alloc(sizeof(lv_obj_t *) * parser->item_cnt);
+    assert(parser->items);
+    for (int j = 0; j < parser->item_cnt; j++)
+    {
+        parser->items[j] = item_create(*scroller);
+    }
+
+    page_scan(parser);
+}
+
+// Decode the thumbnails on the first screen of the pages either side of the current one, so a page change lands
+// with the art already there. They are kept within a share of the memory cache so they cannot push out the
+// current page.
+static void page_prefetch_adjacent(void)
+{
+    dash_thumbcache_stats_t stats;
+    int thumb_w = DASH_THUMBNAIL_WIDTH, thumb_h = DASH_THUMBNAIL_HEIGHT;
+    size_t image_size = JPEG_DECODER_IMAGE_SIZE(thumb_w, thumb_h, THUMBNAIL_COLOUR_DEPTH);
+    size_t used = 0;
+
+    dash_thumbcache_get_stats(&stats);
+    size_t budget = stats.budget_bytes / 100 * DASH_THUMBNAIL_ADJACENT_PERCENT;
+
+    // Count what the adjacent pages already hold or have queued against the budget
+    for (int i = page_current - 1; i <= page_current + 1; i += 2)
+    {
+        parse_handle_t *p = (i >= 0 && i < DASH_MAX_PAGES) ? parsers[i] : NULL;
+        for (int j = 0; p && j < p->item_cnt; j++)
+        {
+            jpg_info_t *jpg_info = ((scroller_item_t *)p->items[j]->user_data)->jpg_info;
+            if (jpg_info && (jpg_info->image || jpg_info->decomp_handle))
+            {
+                used += image_size;
+            }
+        }
+    }
+
+    for (int i = page_current - 1; i <= page_current + 1; i += 2)
+    {
+        parse_handle_t *p = (i >= 0 && i < DASH_MAX_PAGES) ? parsers[i] : NULL;
+        for (int j = 0; p && j < p->item_cnt && used + image_size <= budget; j++)
+        {
+            lv_obj_t *image_container = p->items[j];
+            jpg_info_t *jpg_info = ((scroller_item_t *)image_container->user_data)->jpg_info;
+            int priority = thumbnail_get_priority(image_container);
+            if (priority < 0 || jpg_info == NULL || jpg_info->image || jpg_info->decomp_handle)
+            {
+                continue;
+            }
+            thumbnail_request(image_container, priority);
+            if (jpg_info->image || jpg_info->decomp_handle)
+            {
+                used += image_size;
+            }
+        }
+    }
+}
+
+// Delete the scroller of a page that has not been used for a while. It is built again when it is visited.
+static void page_release(parse_handle_t *parser)
+{
+    lv_obj_del(parser->scroller);
+    parser->scroller = NULL;
+}
+
+// While the user is idle, build the pages either side of the current one so they are ready when the user
+// gets there. Only one page is scanned at a time so it does not hold up the current page.
+static void page_idle_timer(lv_timer_t *t)
+{
+    (void) t;
+    if (parsers[page_current] == NULL)
+    {
+        return;
+    }
+    parsers[page_current]->last_visit = lv_tick_get();
+
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        if (parsers[i] && parsers[i]->scanning)
+        {
+            return;
+        }
+    }
+
+    // Read the pages a rescan changed again, one at a time. The new titles are merged into the page in place.
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        if (parsers[i] && parsers[i]->scroller && parsers[i]->rescan_pending)
+        {
+            page_scan(parsers[i]);
+            return;
+        }
+    }
+
+    if (lv_disp_get_inactive_time(NULL) >= DASH_PAGE_BUILD_IDLE_MS)
+    {
+        for (int i = page_current - 1; i <= page_current + 1; i += 2)
+        {
+            if (i >= 0 && i < DASH_MAX_PAGES && parsers[i] && parsers[i]->scroller == NULL)
+            {
+                page_build(parsers[i]);
+                return;
+            }
+        }
+    }
+
+    // Only once the current page has nothing left to decode
+    if (lv_disp_get_inactive_time(NULL) >= DASH_THUMBNAIL_ADJACENT_IDLE_MS && _lv_ll_get_head(&jpeg_decomp_list) == NULL)
+    {
+        page_prefetch_adjacent();
+    }
+
+    for (int i = 0; i < DASH_MAX_PAGES && DASH_PAGE_RELEASE_MS > 0; i++)
+    {
+        if (parsers[i] && parsers[i]->scroller && LV_ABS(i - page_current) > 1 &&
+            lv_tick_elaps(parsers[i]->last_visit) > DASH_PAGE_RELEASE_MS)
+        {
+            page_release(parsers[i]);
+        }
+    }
+}
+
 void dash_scroller_init()
 {
     lv_coord_t w = lv_obj_get_width(lv_scr_act());
@@ -504,13 +1606,27 @@ void dash_scroller_init()
     page_current = dash_settings.startup_page_index;
 
     lv_memset(parsers, 0, sizeof(parsers));
-    thumbnail_cache = lv_lru_create(thumbnail_cache_size, 175 * 248 * (LV_COLOR_DEPTH + 7) / 8,
-                                    (lv_lru_free_t *)cache_free, NULL);
 
-    jpeg_decoder_init(LV_COLOR_DEPTH, 256);
+    jpeg_decoder_init(THUMBNAIL_COLOUR_DEPTH, DASH_THUMBNAIL_WIDTH, DASH_THUMBNAIL_HEIGHT, DASH_THUMBNAIL_DECODE_THREADS);
+
+    // Decoded thumbnails are kept in memory and on disk so they only need to be decoded once
+    dash_thumbcache_init(DASH_THUMBNAIL_WIDTH, DASH_THUMBNAIL_HEIGHT, THUMBNAIL_COLOUR_DEPTH);
+    dash_thumbcache_set_release_cb(thumbnail_release);
+    jpeg_decoder_set_cache(dash_thumbcache_load, dash_thumbcache_store);
+
+    // Pool enough image buffers to fill the memory cache, plus a preview for every job that can be queued
+    dash_thumbcache_stats_t stats;
+    int thumb_w = DASH_THUMBNAIL_WIDTH, thumb_h = DASH_THUMBNAIL_HEIGHT;
+    dash_thumbcache_get_stats(&stats);
+    jpeg_decoder_reserve_images(stats.budget_bytes / JPEG_DECODER_IMAGE_SIZE(thumb_w, thumb_h, THUMBNAIL_COLOUR_DEPTH) +
+                                JPEG_DECODER_QUEUE_SIZE);
+
+    // Show a blurred preview of each thumbnail straight away while the full decode runs
+    jpeg_decoder_set_preview(jpg_preview_cb);
 
     _lv_ll_init(&jpeg_decomp_list, sizeof(jpeg_ll_value_t));
     lv_timer_create(jpeg_clear_timer, LV_DISP_DEF_REFR_PERIOD, NULL);
+    lv_timer_create(page_idle_timer, 250, NULL);
  
     // Create a tileview object to manage different pages
     page_tiles = lv_tileview_create(lv_scr_act());
@@ -525,6 +1641,18 @@ void dash_scroller_init()
     lv_obj_add_style(label_footer, &titleview_header_footer_style, LV_PART_MAIN);
     lv_label_set_text(label_footer, "");
     lv_obj_update_layout(label_footer);
+
+    // Create the jump index overlay. It lists the buckets of the current page over the middle of the screen
+    label_jump = lv_label_create(lv_scr_act());
+    lv_obj_add_style(label_jump, &titleview_header_footer_style, LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(label_jump, LV_OPA_90, LV_PART_MAIN);
+    lv_obj_set_style_pad_all(label_jump, DASH_YMARGIN / 2, LV_PART_MAIN);
+    lv_obj_set_style_text_align(label_jump, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
+    lv_obj_set_width(label_jump, w - (4 * DASH_XMARGIN));
+    lv_label_set_long_mode(label_jump, LV_LABEL_LONG_WRAP);
+    lv_label_set_recolor(label_jump, true);
+    lv_obj_align(label_jump, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_flag(label_jump, LV_OBJ_FLAG_HIDDEN);
 }
 
 void dash_scroller_scan_db()
@@ -550,59 +1678,26 @@ void dash_scroller_scan_db()
         parse_handle_t *parser = lv_mem_alloc(sizeof(parse_handle_t));
         assert(parser);
         parsers[i] = parser;
-        lv_obj_t **tile = &parser->tile;
-        lv_obj_t **scroller = &parser->scroller;
         lv_memset(parser, 0, sizeof(parse_handle_t));
+        parser->focus_id = -1;
 
         // Create a new page in our tileview
-        *tile = lv_tileview_add_tile(page_tiles, i, 0, LV_DIR_NONE);
-
-        // Create a container that will have our scroller game art
-        *scroller = lv_obj_create(*tile);
-        (*scroller)->user_data = (void *)1; // Store the currently active index here
+        parser->tile = lv_tileview_add_tile(page_tiles, i, 0, LV_DIR_NONE);
 
         // Create a header label for the page from the xml
-        lv_obj_t *label_page_title = lv_label_create(*tile);
+        lv_obj_t *label_page_title = lv_label_create(parser->tile);
         toml_datum_t name_str = toml_string_in(toml_table_at(pages, i), "name");
         if (name_str.ok)
         {
             strncpy(parser->page_title, name_str.u.s, sizeof(parser->page_title) - 1);
         }
+        parser->collection = db_page_is_collection(toml_table_at(pages, i));
         lv_label_set_text(label_page_title, parser->page_title);
         lv_obj_align(label_page_title, LV_ALIGN_TOP_MID, 0, 0);
         lv_obj_add_style(label_page_title, &titleview_header_footer_style, LV_PART_MAIN);
         lv_obj_update_layout(label_page_title);
 
-        // Setup the container for our scrolling game art
-        int sc_parent_w = lv_obj_get_width(lv_obj_get_parent(*scroller));
-        int sc_parent_h = lv_obj_get_height(lv_obj_get_parent(*scroller));
-        // Make the width exactly equal to the highest number of thumbnails that can fit
-        int sc_w = sc_parent_w - (sc_parent_w % DASH_THUMBNAIL_WIDTH);
-        int sc_h = sc_parent_h - lv_obj_get_height(label_page_title) - lv_obj_get_height(label_footer);
-        lv_obj_add_style(*scroller, &titleview_style, LV_PART_MAIN);
-        lv_obj_align(*scroller, LV_ALIGN_TOP_MID, 0, lv_obj_get_height(label_page_title));
-        lv_obj_set_width(*scroller, sc_w);
-        lv_obj_set_height(*scroller, sc_h);
-        // Use flex layout, so new titles automatically get positioned nicely.
-        lv_obj_set_layout(*scroller, LV_LAYOUT_FLEX);
-        lv_obj_set_flex_flow(*scroller, LV_FLEX_FLOW_ROW_WRAP);
-        lv_obj_update_layout(*scroller);
-
-        // Create atleast ONE item in the scroller. This is just a null item when nothing is present
-        title_t *t = lv_mem_alloc(sizeof(title_t));
-        t->db_id = -1;
-        strcpy(t->title, "No item selected");
-        lv_obj_t *null_item = lv_obj_create(*scroller);
-        null_item->user_data = t;
-        lv_obj_add_flag(null_item, LV_OBJ_FLAG_HIDDEN);
-        lv_group_add_obj(lv_group_get_default(), null_item);
-        lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_KEY, NULL);
-        lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_FOCUSED, NULL);
-        lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_DEFOCUSED, NULL);
-
-        // Start a thread that starts reading the database for items on this page.
-        // Thread needs to have a mutex on the database and lvgl
-        parser->db_scan_thread = SDL_CreateThread(db_scan_thread_f, "game_parser_thread", parser);
+        // The rest of the page is built when it is first needed
     }
 }
 
@@ -651,50 +1746,45 @@ bool dash_scroller_get_sort_value(const char *page_title, int *sort_value)
     return true;
 }
 
-struct resort_param
-{
-    int sort_index;
-    lv_obj_t **sorted_objs;
-};
+// qsort has no user pointer. Pages are only resorted from the lvgl thread so a file scope context is fine
+static const title_t *resort_titles;
+static int resort_index;
 
-static int resort_page_callback(void *param, int argc, char **argv, char **azColName)
+// Orders titles the same way as the ORDER BY used when the page was scanned
+static int resort_compare(const void *a, const void *b)
 {
-    (void) param;
-    (void) azColName;
-    (void) argc;
+    const title_t *ta = &resort_titles[*(const int *)a];
+    const title_t *tb = &resort_titles[*(const int *)b];
+    int r;
 
-    assert(argc == 1);
-
-    struct resort_param *p = param;
-    lv_obj_t *scroller = p->sorted_objs[0];
-    int db_id = atoi(argv[0]);
-    lv_task_handler();
-    for (unsigned int i = 1; i < lv_obj_get_child_cnt(scroller); i++)
+    switch (resort_index)
     {
-        lv_obj_t *item_container = lv_obj_get_child(scroller, i);
-        //assert(lv_obj_is_valid(item_container));
-        title_t *t = item_container->user_data;
-        if (t->db_id == db_id)
-        {
-            p->sorted_objs[p->sort_index] = item_container;
-            p->sort_index++;
-            return 0;
-        }
+    case DASH_SORT_RATING:
+        r = (tb->rating > ta->rating) - (tb->rating < ta->rating);
+        break;
+    case DASH_SORT_LAST_LAUNCH:
+        r = strcmp(tb->last_launch, ta->last_launch);
+        break;
+    case DASH_SORT_RELEASE_DATE:
+        r = strcmp(tb->release_date, ta->release_date);
+        break;
+    default:
+        r = strcasecmp(ta->title, tb->title);
     }
-    assert(0);
-    return 0;
+
+    // Titles with equal keys are kept in a fixed order so resorting is repeatable
+    return (r != 0) ? r : (ta->db_id - tb->db_id);
 }
 
 void dash_scroller_resort_page(const char *page_title)
 {
-    char cmd[SQL_MAX_COMMAND_LEN];
     int sort_index;
     if (dash_scroller_get_sort_value(page_title, &sort_index) == false)
     {
         return;
     }
     
-    lv_obj_t *scroller = NULL;
+    parse_handle_t *p = NULL;
     for (int i = 0; i < DASH_MAX_PAGES; i++)
     {
         if (parsers[i] == NULL)
@@ -703,39 +1793,45 @@ void dash_scroller_resort_page(const char *page_title)
         }
         if (strcmp(page_title, parsers[i]->page_title) == 0)
         {
-            scroller = parsers[i]->scroller;
+            p = parsers[i];
             break;
         }
     }
-    assert(scroller);
+    assert(p);
 
-    // If the scroller has no items leave. 1st item is a null item
-    if (lv_obj_get_child_cnt(scroller) <= 1)
+    // If the scroller has no items leave
+    if (p->title_cnt == 0)
     {
         return;
     }
 
-    const char *sort_by;
-    const char *order_by;
-    dash_scroller_get_sort_strings(sort_index, &sort_by, &order_by);
-
-    lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_SORTED_LIST, SQL_TITLE_DB_ID, page_title, sort_by, order_by);
-
-    int child_cnt = lv_obj_get_child_cnt(scroller);
+    // Keep the same title selected wherever it ends up
+    int focus_title = p->order[p->focus_index];
+    lv_obj_t *item_container = get_item(p, p->focus_index);
+    if (item_container)
+    {
+        item_set_focused(item_container, false);
+    }
 
-    struct resort_param *p = lv_mem_alloc(sizeof(struct resort_param));
-    p->sort_index = 1;
-    p->sorted_objs = lv_mem_alloc(sizeof(lv_obj_t *) * child_cnt);
-    
-    lv_memset(p->sorted_objs, 0, sizeof(lv_obj_t *) * child_cnt);
-    p->sorted_objs[0] = scroller;
+    // The sort keys were read with the titles, so this is a single in memory sort of the grid order
+    resort_titles = p->titles;
+    resort_index = sort_index;
+    qsort(p->order, p->title_cnt, sizeof(int), resort_compare);
+    scroller_build_index(p);
+    for (int i = 0; i < p->title_cnt; i++)
+    {
+        if (p->order[i] == focus_title)
+        {
+            p->focus_index = i;
+            break;
+        }
+    }
 
-    db_command_with_callback(cmd, resort_page_callback, p);
-    for (int i = 1; i < child_cnt; i++)
+    // Grid positions do not move, so only the items in view whose title changed are rebound
+    scroller_update_items(p);
+    scroller_scroll_to_index(p, p->focus_index, LV_ANIM_OFF);
+    if (lv_obj_has_state(p->scroller, LV_STATE_FOCUSED))
     {
-        scroller->spec_attr->children[i] = p->sorted_objs[i];
+        scroller_show_focus(p);
     }
-    lv_mem_free(p->sorted_objs);
-    lv_mem_free(p);
-    lv_obj_mark_layout_as_dirty(scroller);
 }
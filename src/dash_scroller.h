@@ -23,6 +23,7 @@ const char *dash_scroller_get_title(int index);
 bool dash_scroller_get_sort_value(const char *page_title, int *sort_value);
 void dash_scroller_resort_page(const char *page_title);
 void dash_scroller_clear_page(const char *page_title);
+void dash_scroller_apply_changes(const db_change_t *changes, int change_cnt);
 int dash_scroller_get_page_count();
 #ifdef __cplusplus
 }
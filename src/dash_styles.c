@@ -10,6 +10,7 @@ lv_style_t menu_table_cell_style;
 lv_style_t object_style;
 lv_style_t titleview_style;
 lv_style_t titleview_image_container_style;
+lv_style_t titleview_image_container_focused_style;
 lv_style_t titleview_image_text_style;
 lv_style_t titleview_header_footer_style;
 lv_color_t dash_base_theme_color;
@@ -87,6 +88,11 @@ void dash_styles_init(lv_color_t theme_colour)
     lv_style_set_pad_all(&titleview_image_container_style, 0);
     lv_style_set_border_width(&titleview_image_container_style, 1);
 
+    // Added to the image containers for LV_STATE_FOCUSED so moving the selection only changes state
+    lv_style_init(&titleview_image_container_focused_style);
+    lv_style_set_border_color(&titleview_image_container_focused_style, lv_color_white());
+    lv_style_set_border_width(&titleview_image_container_focused_style, 2);
+
     // Create a style for the text that appears on the thumbnail art when no artwork is found
     lv_style_init(&titleview_image_text_style);
     lv_style_set_align(&titleview_image_text_style, LV_ALIGN_CENTER);
@@ -112,6 +118,7 @@ void dash_styles_deinit(void)
     lv_style_reset(&object_style);
     lv_style_reset(&titleview_style);
     lv_style_reset(&titleview_image_container_style);
+    lv_style_reset(&titleview_image_container_focused_style);
     lv_style_reset(&titleview_image_text_style);
     lv_style_reset(&titleview_header_footer_style);
 }
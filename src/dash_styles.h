@@ -27,6 +27,7 @@ extern lv_style_t menu_table_cell_style;
 extern lv_style_t object_style;
 extern lv_style_t titleview_style;
 extern lv_style_t titleview_image_container_style;
+extern lv_style_t titleview_image_container_focused_style;
 extern lv_style_t titleview_image_text_style;
 extern lv_style_t titleview_header_footer_style;
 
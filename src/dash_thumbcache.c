@@ -0,0 +1,503 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Persistent cache of thumbnails that have already been decoded and resampled to the on screen size.
+// Everything lives in one file made of fixed size slots so a cached thumbnail is a single aligned read.
+// The front of the file holds an index that maps a hash of each jpeg path to a slot, along with the
+// size and last write time of the jpeg so stale entries are found and rebuilt by the decoder.
+// Once all slots are used the least recently used one is overwritten.
+//
+// In front of that is a memory cache of decoded thumbnails, also keyed by path and file version. Entries are kept
+// after the items using them are deleted so rebuilding or revisiting a page does not decode anything again.
+// It is sized from the free memory at startup and evicts the least recently used thumbnails once over budget.
+
+#include "lithiumx.h"
+#include <src/misc/lv_ll.h>
+
+#define THUMBCACHE_MAGIC 0x4354584C // "LXTC"
+#define THUMBCACHE_VERSION 1
+#define THUMBCACHE_ALIGN 4096
+#define THUMBCACHE_MEM_BUCKETS 256
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t colour_depth;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    uint32_t tick; // Incremented on every access. Used to order entries for LRU eviction
+} thumbcache_header_t;
+
+typedef struct
+{
+    uint64_t key;        // Hash of the jpeg path. 0 if the slot is unused
+    uint64_t write_time; // Last write time of the jpeg when it was cached
+    uint32_t file_size;  // Size of the jpeg when it was cached
+    uint32_t last_used;  // Header tick when this slot was last read or written
+} thumbcache_entry_t;
+
+typedef struct thumbcache_mem_entry
+{
+    uint64_t key;
+    uint64_t write_time;
+    uint32_t file_size;
+    void *mem;   // Allocation from the decoder. Freed on eviction
+    void *image; // Aligned image within mem
+    int w;
+    int h;
+    size_t size;
+    dash_thumbcache_user_t *users;           // Everything currently displaying this thumbnail
+    struct thumbcache_mem_entry *hash_next; // Next entry in the same hash bucket
+} thumbcache_mem_entry_t;
+
+static FILE *thumbcache_fp;
+static SDL_mutex *thumbcache_mutex;
+static thumbcache_header_t thumbcache_header;
+static thumbcache_entry_t *thumbcache_entries;
+static uint32_t thumbcache_data_offset;
+static bool thumbcache_index_dirty;
+
+static bool thumbcache_mem_ready;
+static int thumbcache_mem_depth;
+static lv_ll_t thumbcache_mem_lru; // Head is the most recently used
+static thumbcache_mem_entry_t *thumbcache_mem_buckets[THUMBCACHE_MEM_BUCKETS];
+static dash_thumbcache_release_cb_t thumbcache_release_cb;
+static dash_thumbcache_stats_t thumbcache_stats;
+
+static uint32_t round_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+// FNV-1a. Paths are hashed case insensitive and with either slash so the same file always matches
+static uint64_t thumbcache_hash(const char *path)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*path)
+    {
+        char c = *path++;
+        c = (c == '/') ? '\\' : c;
+        c = (c >= 'A' && c <= 'Z') ? (c + 'a' - 'A') : c;
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ULL;
+    }
+    return (hash == 0) ? 1 : hash;
+}
+
+bool dash_thumbcache_get_version(const char *path, uint32_t *file_size, uint64_t *write_time)
+{
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(path, &findData);
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    FindClose(hFind);
+    if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        return false;
+    }
+    *file_size = findData.nFileSizeLow;
+    *write_time = ((uint64_t)findData.ftLastWriteTime.dwHighDateTime << 32) |
+                  findData.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+static int thumbcache_find(uint64_t key)
+{
+    for (uint32_t i = 0; i < thumbcache_header.slot_count; i++)
+    {
+        if (thumbcache_entries[i].key == key)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void thumbcache_write_index(void)
+{
+    fseek(thumbcache_fp, 0, SEEK_SET);
+    fwrite(&thumbcache_header, sizeof(thumbcache_header_t), 1, thumbcache_fp);
+    fwrite(thumbcache_entries, sizeof(thumbcache_entry_t), thumbcache_header.slot_count, thumbcache_fp);
+    fflush(thumbcache_fp);
+    thumbcache_index_dirty = false;
+}
+
+static void thumbcache_write_entry(int index)
+{
+    fseek(thumbcache_fp, sizeof(thumbcache_header_t) + index * sizeof(thumbcache_entry_t), SEEK_SET);
+    fwrite(&thumbcache_entries[index], sizeof(thumbcache_entry_t), 1, thumbcache_fp);
+    fflush(thumbcache_fp);
+}
+
+static thumbcache_mem_entry_t *thumbcache_mem_find(uint64_t key, uint32_t file_size, uint64_t write_time)
+{
+    thumbcache_mem_entry_t *entry = thumbcache_mem_buckets[key % THUMBCACHE_MEM_BUCKETS];
+    while (entry)
+    {
+        if (entry->key == key && entry->file_size == file_size && entry->write_time == write_time)
+        {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+static void thumbcache_mem_attach(thumbcache_mem_entry_t *entry, dash_thumbcache_user_t *user)
+{
+    user->entry = entry;
+    user->next = entry->users;
+    entry->users = user;
+    _lv_ll_move_before(&thumbcache_mem_lru, entry, _lv_ll_get_head(&thumbcache_mem_lru));
+}
+
+static void thumbcache_mem_evict(thumbcache_mem_entry_t *entry)
+{
+    // Anything still displaying this thumbnail must let go of it first
+    while (entry->users)
+    {
+        dash_thumbcache_user_t *user = entry->users;
+        entry->users = user->next;
+        user->entry = NULL;
+        user->next = NULL;
+        if (thumbcache_release_cb)
+        {
+            thumbcache_release_cb(user);
+        }
+    }
+
+    thumbcache_mem_entry_t **link = &thumbcache_mem_buckets[entry->key % THUMBCACHE_MEM_BUCKETS];
+    while (*link != entry)
+    {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+
+    thumbcache_stats.resident_bytes -= entry->size;
+    thumbcache_stats.entries--;
+    thumbcache_stats.evictions++;
+    jpeg_decoder_free_image(entry->mem);
+    _lv_ll_remove(&thumbcache_mem_lru, entry);
+    lv_mem_free(entry);
+}
+
+// Evict the least recently used thumbnails until we are under budget. Thumbnails that nothing is displaying
+// go first. Only if that is not enough are they taken away from items that are using them.
+static void thumbcache_mem_trim(thumbcache_mem_entry_t *keep)
+{
+    for (int pass = 0; pass < 2 && thumbcache_stats.resident_bytes > thumbcache_stats.budget_bytes; pass++)
+    {
+        thumbcache_mem_entry_t *entry = _lv_ll_get_tail(&thumbcache_mem_lru);
+        while (entry && thumbcache_stats.resident_bytes > thumbcache_stats.budget_bytes)
+        {
+            thumbcache_mem_entry_t *prev = _lv_ll_get_prev(&thumbcache_mem_lru, entry);
+            if (entry != keep && (pass == 1 || entry->users == NULL))
+            {
+                thumbcache_mem_evict(entry);
+            }
+            entry = prev;
+        }
+    }
+}
+
+void dash_thumbcache_init(int w, int h, int colour_depth)
+{
+    if (thumbcache_mem_ready == false)
+    {
+        size_t free_memory = platform_get_free_memory();
+        size_t budget = free_memory / 100 * DASH_THUMBCACHE_MEM_PERCENT;
+        budget = LV_CLAMP(DASH_THUMBCACHE_MEM_MIN, budget, DASH_THUMBCACHE_MEM_MAX);
+
+        _lv_ll_init(&thumbcache_mem_lru, sizeof(thumbcache_mem_entry_t));
+        lv_memset(thumbcache_mem_buckets, 0, sizeof(thumbcache_mem_buckets));
+        lv_memset(&thumbcache_stats, 0, sizeof(thumbcache_stats));
+        thumbcache_stats.budget_bytes = budget;
+        thumbcache_mem_depth = colour_depth;
+        thumbcache_mem_ready = true;
+        dash_printf(LEVEL_TRACE, "Thumbnail memory cache is %u kB (%u kB free)\n",
+                    (unsigned int)(budget / 1024), (unsigned int)(free_memory / 1024));
+    }
+
+    // Already open. dash_create() is run again after a database rebuild
+    if (thumbcache_fp != NULL)
+    {
+        return;
+    }
+
+    if (thumbcache_mutex == NULL)
+    {
+        thumbcache_mutex = SDL_CreateMutex();
+    }
+
+    thumbcache_header_t header;
+    lv_memset(&header, 0, sizeof(header));
+    header.magic = THUMBCACHE_MAGIC;
+    header.version = THUMBCACHE_VERSION;
+    header.width = w;
+    header.height = h;
+    header.colour_depth = colour_depth;
+    header.slot_size = round_up(JPEG_DECODER_IMAGE_SIZE(w, h, colour_depth), THUMBCACHE_ALIGN);
+    header.slot_count = DASH_THUMBCACHE_MAX_SIZE / header.slot_size;
+    if (header.slot_count == 0)
+    {
+        return;
+    }
+
+    thumbcache_entries = lv_mem_alloc(header.slot_count * sizeof(thumbcache_entry_t));
+    if (thumbcache_entries == NULL)
+    {
+        return;
+    }
+
+    thumbcache_fp = fopen(DASH_THUMBCACHE_PATH, "r+b");
+    if (thumbcache_fp == NULL)
+    {
+        thumbcache_fp = fopen(DASH_THUMBCACHE_PATH, "w+b");
+    }
+    if (thumbcache_fp == NULL)
+    {
+        dash_printf(LEVEL_WARN, "Could not open thumbnail cache %s\n", DASH_THUMBCACHE_PATH);
+        lv_mem_free(thumbcache_entries);
+        thumbcache_entries = NULL;
+        return;
+    }
+
+    // The data area starts on an aligned boundary after the header and index
+    thumbcache_data_offset = round_up(sizeof(thumbcache_header_t) +
+                                      header.slot_count * sizeof(thumbcache_entry_t), THUMBCACHE_ALIGN);
+
+    // Check the existing cache was made with the same settings. Otherwise start again
+    bool valid = fread(&thumbcache_header, sizeof(thumbcache_header_t), 1, thumbcache_fp) == 1 &&
+                 thumbcache_header.magic == header.magic &&
+                 thumbcache_header.version == header.version &&
+                 thumbcache_header.width == header.width &&
+                 thumbcache_header.height == header.height &&
+                 thumbcache_header.colour_depth == header.colour_depth &&
+                 thumbcache_header.slot_size == header.slot_size &&
+                 thumbcache_header.slot_count == header.slot_count &&
+                 fread(thumbcache_entries, sizeof(thumbcache_entry_t),
+                       header.slot_count, thumbcache_fp) == header.slot_count;
+
+    if (valid == false)
+    {
+        dash_printf(LEVEL_TRACE, "Thumbnail cache %s is invalid or for a different size. Resetting\n",
+                    DASH_THUMBCACHE_PATH);
+        thumbcache_header = header;
+        lv_memset(thumbcache_entries, 0, header.slot_count * sizeof(thumbcache_entry_t));
+        thumbcache_write_index();
+    }
+    thumbcache_index_dirty = false;
+}
+
+void dash_thumbcache_deinit(void)
+{
+    if (thumbcache_fp == NULL)
+    {
+        return;
+    }
+    SDL_LockMutex(thumbcache_mutex);
+    if (thumbcache_index_dirty)
+    {
+        thumbcache_write_index();
+    }
+    fclose(thumbcache_fp);
+    thumbcache_fp = NULL;
+    lv_mem_free(thumbcache_entries);
+    thumbcache_entries = NULL;
+    SDL_UnlockMutex(thumbcache_mutex);
+}
+
+bool dash_thumbcache_load(const char *path, void *img, int w, int h, int colour_depth)
+{
+    uint32_t file_size;
+    uint64_t write_time;
+    bool ok = false;
+
+    if (thumbcache_fp == NULL || (uint32_t)w != thumbcache_header.width ||
+        (uint32_t)h != thumbcache_header.height || (uint32_t)colour_depth != thumbcache_header.colour_depth)
+    {
+        return false;
+    }
+
+    if (dash_thumbcache_get_version(path, &file_size, &write_time) == false)
+    {
+        return false;
+    }
+
+    uint64_t key = thumbcache_hash(path);
+    SDL_LockMutex(thumbcache_mutex);
+    int index = thumbcache_find(key);
+    if (index >= 0)
+    {
+        thumbcache_entry_t *entry = &thumbcache_entries[index];
+        // If the jpeg has changed since it was cached, treat it as a miss. It will be decoded again
+        // and the new image stored over the top of this slot.
+        if (entry->file_size == file_size && entry->write_time == write_time)
+        {
+            size_t len = JPEG_DECODER_IMAGE_SIZE(w, h, colour_depth);
+            fseek(thumbcache_fp, thumbcache_data_offset + index * thumbcache_header.slot_size, SEEK_SET);
+            ok = fread(img, 1, len, thumbcache_fp) == len;
+            entry->last_used = ++thumbcache_header.tick;
+            thumbcache_index_dirty = true;
+        }
+    }
+    SDL_UnlockMutex(thumbcache_mutex);
+    return ok;
+}
+
+void dash_thumbcache_store(const char *path, const void *img, int w, int h, int colour_depth)
+{
+    uint32_t file_size;
+    uint64_t write_time;
+
+    if (thumbcache_fp == NULL || (uint32_t)w != thumbcache_header.width ||
+        (uint32_t)h != thumbcache_header.height || (uint32_t)colour_depth != thumbcache_header.colour_depth)
+    {
+        return;
+    }
+
+    if (dash_thumbcache_get_version(path, &file_size, &write_time) == false)
+    {
+        return;
+    }
+
+    uint64_t key = thumbcache_hash(path);
+    SDL_LockMutex(thumbcache_mutex);
+
+    // Reuse this path's slot if it has one (it was stale), otherwise the first free slot,
+    // otherwise evict the least recently used. Free slots are always used lowest first so the
+    // file only ever grows by one slot at a time.
+    int index = thumbcache_find(key);
+    if (index < 0)
+    {
+        index = thumbcache_find(0);
+    }
+    if (index < 0)
+    {
+        index = 0;
+        for (uint32_t i = 1; i < thumbcache_header.slot_count; i++)
+        {
+            // Compare relative to the current tick so this still works when the tick wraps
+            if ((uint32_t)(thumbcache_header.tick - thumbcache_entries[i].last_used) >
+                (uint32_t)(thumbcache_header.tick - thumbcache_entries[index].last_used))
+            {
+                index = i;
+            }
+        }
+    }
+
+    // Invalidate the slot while its pixels are being replaced, in case we lose power part way through
+    thumbcache_entry_t *entry = &thumbcache_entries[index];
+    entry->key = 0;
+    thumbcache_write_entry(index);
+
+    size_t len = JPEG_DECODER_IMAGE_SIZE(w, h, colour_depth);
+    fseek(thumbcache_fp, thumbcache_data_offset + index * thumbcache_header.slot_size, SEEK_SET);
+    if (fwrite(img, 1, len, thumbcache_fp) == len)
+    {
+        entry->key = key;
+        entry->file_size = file_size;
+        entry->write_time = write_time;
+        entry->last_used = ++thumbcache_header.tick;
+    }
+    thumbcache_write_index();
+    SDL_UnlockMutex(thumbcache_mutex);
+}
+
+void dash_thumbcache_set_release_cb(dash_thumbcache_release_cb_t release_cb)
+{
+    thumbcache_release_cb = release_cb;
+}
+
+void *dash_thumbcache_mem_attach(dash_thumbcache_user_t *user, const char *path, uint32_t file_size,
+                                 uint64_t write_time, int *w, int *h)
+{
+    if (thumbcache_mem_ready == false)
+    {
+        return NULL;
+    }
+
+    dash_thumbcache_mem_detach(user);
+    thumbcache_mem_entry_t *entry = thumbcache_mem_find(thumbcache_hash(path), file_size, write_time);
+    if (entry == NULL)
+    {
+        thumbcache_stats.misses++;
+        return NULL;
+    }
+    thumbcache_stats.hits++;
+    thumbcache_mem_attach(entry, user);
+    *w = entry->w;
+    *h = entry->h;
+    return entry->image;
+}
+
+void *dash_thumbcache_mem_insert(dash_thumbcache_user_t *user, const char *path, uint32_t file_size,
+                                 uint64_t write_time, void *mem, void *image, int w, int h)
+{
+    assert(thumbcache_mem_ready);
+    uint64_t key = thumbcache_hash(path);
+
+    dash_thumbcache_mem_detach(user);
+    thumbcache_mem_entry_t *entry = thumbcache_mem_find(key, file_size, write_time);
+    if (entry != NULL)
+    {
+        // Something else decoded the same thumbnail first. Share that one
+        jpeg_decoder_free_image(mem);
+    }
+    else
+    {
+        entry = _lv_ll_ins_head(&thumbcache_mem_lru);
+        if (entry == NULL)
+        {
+            jpeg_decoder_free_image(mem);
+            return NULL;
+        }
+        lv_memset(entry, 0, sizeof(thumbcache_mem_entry_t));
+        entry->key = key;
+        entry->file_size = file_size;
+        entry->write_time = write_time;
+        entry->mem = mem;
+        entry->image = image;
+        entry->w = w;
+        entry->h = h;
+        entry->size = JPEG_DECODER_IMAGE_SIZE(w, h, thumbcache_mem_depth);
+        entry->hash_next = thumbcache_mem_buckets[key % THUMBCACHE_MEM_BUCKETS];
+        thumbcache_mem_buckets[key % THUMBCACHE_MEM_BUCKETS] = entry;
+        thumbcache_stats.resident_bytes += entry->size;
+        thumbcache_stats.entries++;
+    }
+    thumbcache_mem_attach(entry, user);
+    thumbcache_mem_trim(entry);
+    return entry->image;
+}
+
+void dash_thumbcache_mem_detach(dash_thumbcache_user_t *user)
+{
+    thumbcache_mem_entry_t *entry = user->entry;
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    dash_thumbcache_user_t **link = &entry->users;
+    while (*link != NULL && *link != user)
+    {
+        link = &(*link)->next;
+    }
+    if (*link == user)
+    {
+        *link = user->next;
+    }
+    user->entry = NULL;
+    user->next = NULL;
+}
+
+void dash_thumbcache_get_stats(dash_thumbcache_stats_t *stats)
+{
+    *stats = thumbcache_stats;
+}
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#ifndef _DASH_THUMBCACHE_H
+#define _DASH_THUMBCACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lithiumx.h"
+
+// Maximum size of the on disk thumbnail cache file in bytes. The oldest thumbnails are evicted
+// once this is full
+#ifndef DASH_THUMBCACHE_MAX_SIZE
+#define DASH_THUMBCACHE_MAX_SIZE (64U * 1024U * 1024U)
+#endif
+
+// Percentage of the free memory at startup used to keep decoded thumbnails in RAM,
+// clamped between DASH_THUMBCACHE_MEM_MIN and DASH_THUMBCACHE_MEM_MAX bytes
+#ifndef DASH_THUMBCACHE_MEM_PERCENT
+#define DASH_THUMBCACHE_MEM_PERCENT 40
+#endif
+
+#ifndef DASH_THUMBCACHE_MEM_MIN
+#define DASH_THUMBCACHE_MEM_MIN (4U * 1024U * 1024U)
+#endif
+
+#ifndef DASH_THUMBCACHE_MEM_MAX
+#define DASH_THUMBCACHE_MEM_MAX (256U * 1024U * 1024U)
+#endif
+
+// Embedded in anything that displays a thumbnail from the memory cache. An entry is only evicted while
+// it has users if the cache cannot get under budget otherwise, in which case each user is released first.
+typedef struct dash_thumbcache_user
+{
+    void *user_data;                   // Not used by the cache. Available to the release callback
+    void *entry;                       // The cache entry this user is attached to, or NULL
+    struct dash_thumbcache_user *next; // Next user attached to the same entry
+} dash_thumbcache_user_t;
+
+// Called when an entry is evicted while still in use. The user must stop using the image.
+typedef void (*dash_thumbcache_release_cb_t)(dash_thumbcache_user_t *user);
+
+typedef struct
+{
+    uint32_t hits;         // Lookups that found the thumbnail in memory
+    uint32_t misses;       // Lookups that had to decode the thumbnail
+    uint32_t evictions;    // Thumbnails dropped from memory to stay under budget
+    uint32_t entries;      // Thumbnails currently in memory
+    size_t resident_bytes; // Bytes currently used by thumbnails in memory
+    size_t budget_bytes;   // Maximum bytes the memory cache will use
+} dash_thumbcache_stats_t;
+
+/*
+ * Open (or create) the on disk thumbnail cache for thumbnails of w x h pixels at colour_depth bpp, or JPEG_DECODER_DXT1.
+ * If the existing cache was made for a different size or depth it is reset.
+ * The first call also sizes the memory cache from the free memory at the time.
+ */
+void dash_thumbcache_init(int w, int h, int colour_depth);
+
+/*
+ * Write any pending index changes to disk and close the cache file.
+ */
+void dash_thumbcache_deinit(void);
+
+/*
+ * Read a cached thumbnail for the jpeg at path into img. Returns false if there is no cached copy,
+ * or the jpeg has changed since it was cached. Matches jpg_cache_load_cb_t.
+ */
+bool dash_thumbcache_load(const char *path, void *img, int w, int h, int colour_depth);
+
+/*
+ * Store a decoded thumbnail for the jpeg at path. Matches jpg_cache_store_cb_t.
+ */
+void dash_thumbcache_store(const char *path, const void *img, int w, int h, int colour_depth);
+
+/*
+ * Get the size and last write time of a file. These are used to tell if a cached thumbnail is stale.
+ * Returns false if the file does not exist or is a directory.
+ */
+bool dash_thumbcache_get_version(const char *path, uint32_t *file_size, uint64_t *write_time);
+
+/*
+ * The memory cache keeps decoded thumbnails keyed by path and file version, so they outlive the
+ * items that display them. All memory cache functions must be called with the lvgl lock held.
+ */
+void dash_thumbcache_set_release_cb(dash_thumbcache_release_cb_t release_cb);
+
+/*
+ * Look up a thumbnail in memory. On a hit user is attached to it and the image is returned.
+ * Returns NULL on a miss.
+ */
+void *dash_thumbcache_mem_attach(dash_thumbcache_user_t *user, const char *path, uint32_t file_size,
+                                 uint64_t write_time, int *w, int *h);
+
+/*
+ * Add a newly decoded thumbnail to memory and attach user to it. The cache takes ownership of mem
+ * and frees it with jpeg_decoder_free_image() when evicted. Returns the image that user should display, which may be
+ * an existing copy if the same thumbnail was already in memory.
+ */
+void *dash_thumbcache_mem_insert(dash_thumbcache_user_t *user, const char *path, uint32_t file_size,
+                                 uint64_t write_time, void *mem, void *image, int w, int h);
+
+/*
+ * Stop using a thumbnail. It stays in memory until it is evicted.
+ */
+void dash_thumbcache_mem_detach(dash_thumbcache_user_t *user);
+
+void dash_thumbcache_get_stats(dash_thumbcache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
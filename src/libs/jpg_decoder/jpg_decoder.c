@@ -1,48 +1,144 @@
 // SPDX-License-Identifier: MIT
 // SPDX-FileCopyrightText: 2022 Ryzee119
 
-/* Uses jpegturbo to decompress a jpeg file. Decompression is run in a different thread to minimise blocking.
+/* Uses jpegturbo to decompress a jpeg file. Decompression is run in a pool of worker threads to minimise blocking.
  * jpegs are queued with jpeg_decoder_queue(). A callback is made when the compression is complete.
  * Up to JPEG_DECODER_QUEUE_SIZE
- * files can be queued.
+ * files can be queued. The queue is a binary heap ordered by priority, so the most important job is always decoded
+ * next and priorities can be changed while a job waits. The heap belongs to the IO thread. Queueing, changing priority
+ * and aborting never take a lock. Jobs are handed over through bounded lock free rings, and every handle carries a
+ * generation count so a handle to a job that has finished and had its slot reused is ignored. Loading is a two stage pipeline. An IO thread reads each
+ * whole file into one of a small pool of buffers, then the decode workers decode it from memory. This keeps the disk
+ * and CPU busy at the same time, and jobs aborted before they are decoded never touch the decoder.
+ * If a preview callback is set, each jpeg is first decoded at 1/8 scale as a quick blurred placeholder. Previews are
+ * done before any full decode so fast scrolling puts something on screen straight away.
+ * All workers pull from the same queue so on multi-core hosts several files are
+ * decoded at once. Workers run at low thread priority and yield between scanline batches rather than sleeping.
  * SDL2 is used for portable thread, mutex and atomic support
  */
 
 #include <SDL.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <setjmp.h>
 #include <jpeglib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "jpg_decoder.h"
 
+#if JPEG_DECODER_QUEUE_SIZE > 256
+#error "JPEG_DECODER_QUEUE_SIZE must fit in the 8 bit index of a handle"
+#endif
+
 typedef enum
 {
-    STATE_FREE,          // Mempool item free and ready to use
-    STATE_DECOMP_QUEUED, // Mempool item currently queued
-    STATE_DECOMP_ABORTED // Mempool item had started decompression, but was aborted
+    STATE_FREE,                     // Mempool item free and ready to use
+    STATE_DECOMP_QUEUED,            // Mempool item currently queued or being decoded
+    STATE_DECOMP_DELIVERING,        // A callback for this item is running
+    STATE_DECOMP_ABORTED,           // Mempool item was aborted. No callbacks will be made
+    STATE_DECOMP_DELIVERING_ABORTED // Aborted while a callback was running. No more callbacks will be made after it
 } jpeg_image_state_t;
 
+// Who is responsible for a queued job
+typedef enum
+{
+    LOCATION_SUBMITTED, // Queued or sent back by a worker. The IO thread has not put it in the heap yet
+    LOCATION_HEAP,      // Waiting in the IO thread's heap
+    LOCATION_PIPELINE   // Read or being read. The IO thread drops aborted jobs still in jpegdecomp_ready, the rest are checked
+                        // by whoever holds them
+} jpeg_location_t;
+
+// A job's state and generation are kept in one atomic so a handle can be checked and acted on in one step.
+// The generation is bumped every time the job goes back to the mempool, which makes any old handles stale.
+// Handles are the generation << 8 | mempool index. The generation is never 0 so neither is a handle.
+#define JOB_TAG(generation, state) ((int)(((uint32_t)(generation) << 4) | (state)))
+#define JOB_STATE(tag) ((tag) & 0xF)
+#define JOB_GENERATION(tag) ((uint32_t)(tag) >> 4)
+#define JOB_GENERATION_MAX 0xFFFFFF
+
+// Bounded lock free multi producer, multi consumer ring of mempool indices. Each cell's sequence tells
+// producers and consumers whether it is their turn to use it.
+#define JPEG_RING_SIZE 256 // Power of two, at least JPEG_DECODER_QUEUE_SIZE
+typedef struct
+{
+    SDL_atomic_t sequence;
+    int value;
+} jpeg_ring_cell_t;
+
+typedef struct
+{
+    jpeg_ring_cell_t cells[JPEG_RING_SIZE];
+    SDL_atomic_t head; // Next position to push to
+    SDL_atomic_t tail; // Next position to pop from
+} jpeg_ring_t;
+
 typedef struct jpeg
 {
     char fn[256];       // Stores the filename for this jpeg
-    SDL_atomic_t state; // jpeg_image_state_t. Track state of jpeg decompression
+    SDL_atomic_t state; // JOB_TAG of the generation and jpeg_image_state_t. Track state of jpeg decompression
     void *user_data;    // User data to be returned on complete_cb;
     uint8_t *mem;
     uint8_t *decompressed_image;
+    uint8_t *scratch;   // malloc'd decode buffer for the resampler. Freed on the libjpeg error path too
     jpg_complete_cb_t complete_cb; // Callback for jpeg decompression complete. Warning: Called from decomp thread context.
-    struct jpeg *next;             // Singley linked list for decompression queue
+    SDL_atomic_t priority;         // Lower values are decoded first. Can be changed by the user at any time
+    int heap_priority;             // Copy of priority the heap is ordered by. Only the IO thread changes it
+    SDL_atomic_t location;         // jpeg_location_t
+    SDL_atomic_t pending;          // 1 while the job is in jpegdecomp_submitted waiting for the IO thread
+    uint32_t sequence;             // Queue order. Jobs of equal priority are decoded first in, first out
+    int heap_index;                // Position in jpegdecomp_heap, or -1 if not waiting in the queue
+    int ready_index;               // Position in jpegdecomp_ready, or -1 if not waiting for a decode worker
+    int io_buffer;                 // Index of the jpeg_io_buffers entry holding the file, or -1
+    size_t file_len;               // Length of the file in io_buffer
+    bool cache_checked;            // The user cache has been checked for this jpeg already
+    bool preview_done;             // The preview has been made (or is not wanted). Next pass is the full decode
 } jpeg_t;
 
 static int jpeg_decoder_running = 0;
-static int jpeg_colour_depth;                      // What colour depth should the decompress jpeg be (16 (RGB565) or 32 (BGRA))
-static int jpeg_max_dimension;                     // The maximum output dimension of the width or height (whichever is larger)
-static SDL_mutex *jpegdecomp_qmutex;               // Mutex for the jpeg decompressor thread queue
-static SDL_sem *jpegdecomp_queue;                  // Semaphore to track nubmer of items in decompressor queue
-static SDL_Thread *jpegdecomp_thread;              // Thread for the jpeg decompressor
+static int jpeg_colour_depth;                      // What colour depth should the decompress jpeg be (16 (RGB565), 32 (BGRA) or JPEG_DECODER_DXT1)
+static int jpeg_out_width;                         // Every image is resampled to exactly this width
+static int jpeg_out_height;                        // Every image is resampled to exactly this height
+static int jpegdecomp_num_threads;                 // Number of worker threads in jpegdecomp_threads
+static SDL_mutex *jpegdecomp_qmutex;               // Protects the ready list and io buffers shared by the IO thread and workers
+static SDL_sem *jpeg_io_wake;                      // Posted when there is something new for the IO thread to do
+static SDL_sem *jpegdecomp_ready_sem;              // Semaphore to track number of items in jpegdecomp_ready
+static SDL_Thread *jpegdecomp_threads[JPEG_DECODER_MAX_THREADS]; // Worker threads for the jpeg decompressor
+static SDL_Thread *jpeg_io_thread;                 // Reads queued files into memory for the decode workers
+static int jpeg_io_num_buffers;                    // Number of buffers in use from jpeg_io_buffers
+static SDL_sem *jpeg_io_buffers_free;              // Semaphore to track number of unused io buffers
+static uint8_t *jpeg_io_buffers[JPEG_DECODER_MAX_IO_BUFFERS]; // Whole files are read into these. They grow to fit
+static size_t jpeg_io_buffer_size[JPEG_DECODER_MAX_IO_BUFFERS];
+static bool jpeg_io_buffer_used[JPEG_DECODER_MAX_IO_BUFFERS];
+static jpeg_t *jpegdecomp_ready[JPEG_DECODER_MAX_IO_BUFFERS]; // Files in memory waiting for a decode worker
+static int jpegdecomp_ready_count;                 // Number of jpegs in jpegdecomp_ready
 static jpeg_t jpeg_mpool[JPEG_DECODER_QUEUE_SIZE]; // Local mempool for jpeg objects
-static jpeg_t *jpeg_mpool_free;                    // Stores a free pointer in mempool that can be used to quickly allocate from pool
-static jpeg_t *jpegdecomp_qhead;                   // Tracks a singly linked list of queued jpegs for decompression in thread
-static jpeg_t *jpegdecomp_qtail;                   // Tracks a singly linked list of queued jpegs for decompression in thread
+static jpeg_ring_t jpeg_mpool_free;                // Indices of free jpeg_mpool items
+static jpeg_ring_t jpegdecomp_submitted;           // Jobs the IO thread needs to look at. New, re-ranked or aborted
+static jpeg_t *jpegdecomp_heap[JPEG_DECODER_QUEUE_SIZE]; // Min heap of queued jpegs waiting for a worker. IO thread only
+static int jpegdecomp_heap_size;                   // Number of jpegs in jpegdecomp_heap
+static SDL_atomic_t jpegdecomp_sequence;           // Incremented for every queued jpeg
+static jpg_cache_load_cb_t jpeg_cache_load;        // Optional user cache checked before decoding
+static jpg_cache_store_cb_t jpeg_cache_store;      // Optional user cache given every decoded image
+static jpg_complete_cb_t jpeg_preview_cb;          // Optional callback for quick low quality previews
+
+// Decoded images come from a pool of fixed size slots so the heap is not churned by large allocations that are all
+// the same size. Slots are allocated in chunks as needed, up to jpeg_image_max_slots, and then reused. Every image
+// buffer starts with a jpeg_image_hdr_t and the image follows at the next JPEG_DECODER_IMAGE_ALIGN boundary.
+// The pool is kept for the life of the program as images can outlive the decoder.
+#define JPEG_IMAGE_CHUNK_SLOTS 16
+typedef struct jpeg_image_hdr
+{
+    struct jpeg_image_hdr *next; // Next free slot in jpeg_image_free
+    bool pooled;                 // False if this buffer was allocated from the heap because the pool was full
+} jpeg_image_hdr_t;
+static SDL_mutex *jpeg_image_mutex;                // Protects the image pool. Images are freed from the user's threads
+static jpeg_image_hdr_t *jpeg_image_free;          // Free list of pooled image slots
+static size_t jpeg_image_size;                     // Size of each image in jpeg_colour_depth format
+static size_t jpeg_image_slot_size;                // Size of each pooled slot including the header
+static int jpeg_image_slots;                       // Number of pool slots allocated so far
+static int jpeg_image_max_slots;                   // Number of pool slots reserved with jpeg_decoder_reserve_images()
 
 struct jpeg_decoder_error_mgr {
   struct jpeg_error_mgr pub;
@@ -56,6 +152,93 @@ static void error_exit_stub(j_common_ptr cinfo)
     longjmp(myerr->setjmp_buffer, 1);
 }
 
+static bool job_before(const jpeg_t *a, int a_priority, const jpeg_t *b, int b_priority)
+{
+    // Jobs waiting for a preview go first so every visible thumbnail gets something on screen quickly
+    if (a->preview_done != b->preview_done)
+    {
+        return b->preview_done;
+    }
+    if (a_priority != b_priority)
+    {
+        return a_priority < b_priority;
+    }
+    return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+// Heap helpers. Only the IO thread uses the heap.
+static bool heap_before(const jpeg_t *a, const jpeg_t *b)
+{
+    return job_before(a, a->heap_priority, b, b->heap_priority);
+}
+
+static void heap_set(int index, jpeg_t *jpeg)
+{
+    jpegdecomp_heap[index] = jpeg;
+    jpeg->heap_index = index;
+}
+
+static void heap_sift_up(int index)
+{
+    jpeg_t *jpeg = jpegdecomp_heap[index];
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (heap_before(jpeg, jpegdecomp_heap[parent]) == false)
+        {
+            break;
+        }
+        heap_set(index, jpegdecomp_heap[parent]);
+        index = parent;
+    }
+    heap_set(index, jpeg);
+}
+
+static void heap_sift_down(int index)
+{
+    jpeg_t *jpeg = jpegdecomp_heap[index];
+    while (1)
+    {
+        int child = index * 2 + 1;
+        if (child >= jpegdecomp_heap_size)
+        {
+            break;
+        }
+        if (child + 1 < jpegdecomp_heap_size && heap_before(jpegdecomp_heap[child + 1], jpegdecomp_heap[child]))
+        {
+            child++;
+        }
+        if (heap_before(jpegdecomp_heap[child], jpeg) == false)
+        {
+            break;
+        }
+        heap_set(index, jpegdecomp_heap[child]);
+        index = child;
+    }
+    heap_set(index, jpeg);
+}
+
+static void heap_push(jpeg_t *jpeg)
+{
+    heap_set(jpegdecomp_heap_size++, jpeg);
+    heap_sift_up(jpeg->heap_index);
+}
+
+static void heap_remove(jpeg_t *jpeg)
+{
+    int index = jpeg->heap_index;
+    jpeg_t *last = jpegdecomp_heap[--jpegdecomp_heap_size];
+    jpeg->heap_index = -1;
+    if (last == jpeg)
+    {
+        return;
+    }
+    // Move the last item into the hole then restore the heap in whichever direction it needs
+    heap_set(index, last);
+    heap_sift_up(index);
+    heap_sift_down(last->heap_index);
+}
+
 static void* align_pointer(void* ptr, int align)
 {
     uintptr_t address = (uintptr_t)ptr;
@@ -67,38 +250,886 @@ static void* align_pointer(void* ptr, int align)
     return (void*)address;
 }
 
-static int decomp_thread(void *ptr)
+static void ring_init(jpeg_ring_t *ring)
+{
+    for (int i = 0; i < JPEG_RING_SIZE; i++)
+    {
+        SDL_AtomicSet(&ring->cells[i].sequence, i);
+    }
+    SDL_AtomicSet(&ring->head, 0);
+    SDL_AtomicSet(&ring->tail, 0);
+}
+
+static bool ring_push(jpeg_ring_t *ring, int value)
+{
+    jpeg_ring_cell_t *cell;
+    int pos = SDL_AtomicGet(&ring->head);
+    while (1)
+    {
+        cell = &ring->cells[pos & (JPEG_RING_SIZE - 1)];
+        int diff = (int)((uint32_t)SDL_AtomicGet(&cell->sequence) - (uint32_t)pos);
+        if (diff == 0)
+        {
+            if (SDL_AtomicCAS(&ring->head, pos, pos + 1))
+            {
+                break;
+            }
+            pos = SDL_AtomicGet(&ring->head);
+        }
+        else if (diff < 0)
+        {
+            return false; // Full
+        }
+        else
+        {
+            pos = SDL_AtomicGet(&ring->head); // Another producer took this cell
+        }
+    }
+    cell->value = value;
+    SDL_AtomicSet(&cell->sequence, pos + 1);
+    return true;
+}
+
+static bool ring_pop(jpeg_ring_t *ring, int *value)
+{
+    jpeg_ring_cell_t *cell;
+    int pos = SDL_AtomicGet(&ring->tail);
+    while (1)
+    {
+        cell = &ring->cells[pos & (JPEG_RING_SIZE - 1)];
+        int diff = (int)((uint32_t)SDL_AtomicGet(&cell->sequence) - (uint32_t)(pos + 1));
+        if (diff == 0)
+        {
+            if (SDL_AtomicCAS(&ring->tail, pos, pos + 1))
+            {
+                break;
+            }
+            pos = SDL_AtomicGet(&ring->tail);
+        }
+        else if (diff < 0)
+        {
+            return false; // Empty
+        }
+        else
+        {
+            pos = SDL_AtomicGet(&ring->tail); // Another consumer took this cell
+        }
+    }
+    *value = cell->value;
+    SDL_AtomicSet(&cell->sequence, pos + JPEG_RING_SIZE);
+    return true;
+}
+
+static void *job_handle(jpeg_t *jpeg, uint32_t generation)
+{
+    return (void *)(uintptr_t)((generation << 8) | (uint32_t)(jpeg - jpeg_mpool));
+}
+
+static jpeg_t *job_from_handle(void *handle, uint32_t *generation)
+{
+    uint32_t value = (uint32_t)(uintptr_t)handle;
+    if (handle == NULL || (value & 0xFF) >= JPEG_DECODER_QUEUE_SIZE)
+    {
+        return NULL;
+    }
+    *generation = value >> 8;
+    return &jpeg_mpool[value & 0xFF];
+}
+
+// Ask the IO thread to look at a job. Each job is in jpegdecomp_submitted at most once so it can never fill up.
+static void job_notify(jpeg_t *jpeg)
+{
+    if (SDL_AtomicCAS(&jpeg->pending, 0, 1))
+    {
+        ring_push(&jpegdecomp_submitted, (int)(jpeg - jpeg_mpool));
+        SDL_SemPost(jpeg_io_wake);
+    }
+}
+
+// Call before making a callback. Returns false if the job was aborted, in which case no callback should be made.
+static bool job_begin_callback(jpeg_t *jpeg)
+{
+    int tag = SDL_AtomicGet(&jpeg->state);
+    return SDL_AtomicCAS(&jpeg->state, JOB_TAG(JOB_GENERATION(tag), STATE_DECOMP_QUEUED),
+                         JOB_TAG(JOB_GENERATION(tag), STATE_DECOMP_DELIVERING));
+}
+
+// Call after a callback if the job carries on. If it was aborted during the callback it is marked aborted.
+static void job_end_callback(jpeg_t *jpeg)
 {
+    uint32_t generation = JOB_GENERATION(SDL_AtomicGet(&jpeg->state));
+    if (SDL_AtomicCAS(&jpeg->state, JOB_TAG(generation, STATE_DECOMP_DELIVERING),
+                      JOB_TAG(generation, STATE_DECOMP_QUEUED)) == false)
+    {
+        SDL_AtomicSet(&jpeg->state, JOB_TAG(generation, STATE_DECOMP_ABORTED));
+    }
+}
+
+static bool job_aborted(jpeg_t *jpeg)
+{
+    return JOB_STATE(SDL_AtomicGet(&jpeg->state)) != STATE_DECOMP_QUEUED;
+}
+
+static uint8_t *image_from_mem(void *mem)
+{
+    return align_pointer((uint8_t *)mem + sizeof(jpeg_image_hdr_t), JPEG_DECODER_IMAGE_ALIGN);
+}
+
+// Add up to JPEG_IMAGE_CHUNK_SLOTS slots to the pool. Must be called with jpeg_image_mutex held.
+static void image_pool_grow(void)
+{
+    int count = SDL_min(JPEG_IMAGE_CHUNK_SLOTS, jpeg_image_max_slots - jpeg_image_slots);
+    uint8_t *chunk = malloc(count * jpeg_image_slot_size + JPEG_DECODER_IMAGE_ALIGN);
+    if (chunk == NULL)
+    {
+        return;
+    }
+    chunk = align_pointer(chunk, JPEG_DECODER_IMAGE_ALIGN);
+    for (int i = 0; i < count; i++)
+    {
+        jpeg_image_hdr_t *slot = (jpeg_image_hdr_t *)&chunk[i * jpeg_image_slot_size];
+        slot->pooled = true;
+        slot->next = jpeg_image_free;
+        jpeg_image_free = slot;
+    }
+    jpeg_image_slots += count;
+}
+
+// Get a buffer for one output image. This is the mem passed to the user, the image is at image_from_mem(mem).
+static void *image_alloc(void)
+{
+    jpeg_image_hdr_t *slot;
+
+    SDL_LockMutex(jpeg_image_mutex);
+    if (jpeg_image_free == NULL && jpeg_image_slots < jpeg_image_max_slots)
+    {
+        image_pool_grow();
+    }
+    slot = jpeg_image_free;
+    if (slot != NULL)
+    {
+        jpeg_image_free = slot->next;
+    }
+    SDL_UnlockMutex(jpeg_image_mutex);
+
+    if (slot == NULL)
+    {
+        slot = malloc(sizeof(jpeg_image_hdr_t) + JPEG_DECODER_IMAGE_ALIGN + jpeg_image_size);
+        if (slot != NULL)
+        {
+            slot->pooled = false;
+        }
+    }
+    return slot;
+}
+
+// Area (box) resampler weights are fixed point with this many fractional bits. Each output pixel's weights sum
+// to exactly 1 << RESAMPLE_SHIFT. 14 bits keeps weight * 255 * 2 inside the int32 lanes of _mm_madd_epi16.
+#define RESAMPLE_SHIFT 14
+#define RESAMPLE_ONE (1 << RESAMPLE_SHIFT)
+#define RESAMPLE_ROUND (1 << (RESAMPLE_SHIFT - 1))
+
+typedef struct
+{
+    int taps;          // Max source pixels that contribute to one output pixel
+    int *start;        // First source pixel for each output pixel
+    int16_t *weights;  // taps weights per output pixel. Unused taps have a weight of 0
+} resample_axis_t;
+
+// Upscaling. Each output pixel is a linear blend of the two nearest source pixels.
+static bool resample_axis_init_linear(resample_axis_t *axis, int src_len, int dst_len)
+{
+    axis->taps = 2;
+    axis->start = malloc(dst_len * sizeof(int));
+    axis->weights = malloc(dst_len * axis->taps * sizeof(int16_t));
+    if (axis->start == NULL || axis->weights == NULL)
+    {
+        free(axis->start);
+        free(axis->weights);
+        return false;
+    }
+
+    for (int i = 0; i < dst_len; i++)
+    {
+        // Centre of output pixel i in the source is (i + 0.5) * src_len / dst_len - 0.5.
+        // Work in units of 1 / (2 * dst_len) source pixels so everything stays in integers
+        int64_t pos = (int64_t)(2 * i + 1) * src_len - dst_len;
+        int64_t unit = 2 * (int64_t)dst_len;
+        int first = 0, frac = 0;
+        if (pos > 0)
+        {
+            first = pos / unit;
+            frac = ((pos % unit) * RESAMPLE_ONE) / unit;
+        }
+        // Keep both taps inside the source
+        if (first >= src_len - 1)
+        {
+            first = src_len - 2;
+            frac = RESAMPLE_ONE;
+        }
+        axis->start[i] = first;
+        axis->weights[i * 2 + 0] = RESAMPLE_ONE - frac;
+        axis->weights[i * 2 + 1] = frac;
+    }
+    return true;
+}
+
+// Work out which source pixels overlap each output pixel, and by how much.
+static bool resample_axis_init(resample_axis_t *axis, int src_len, int dst_len)
+{
+    if (dst_len > src_len)
+    {
+        return resample_axis_init_linear(axis, src_len, dst_len);
+    }
+
+    // Output pixel i covers source range [i * src_len / dst_len, (i + 1) * src_len / dst_len)
+    axis->taps = (src_len + dst_len - 1) / dst_len + 1;
+    // Round taps up to even so SIMD can always process source pixels in pairs
+    axis->taps += axis->taps & 1;
+    axis->start = malloc(dst_len * sizeof(int));
+    axis->weights = malloc(dst_len * axis->taps * sizeof(int16_t));
+    if (axis->start == NULL || axis->weights == NULL)
+    {
+        free(axis->start);
+        free(axis->weights);
+        return false;
+    }
+    memset(axis->weights, 0, dst_len * axis->taps * sizeof(int16_t));
+
+    for (int i = 0; i < dst_len; i++)
+    {
+        // Positions in units of 1 / dst_len source pixels so everything stays in integers
+        int64_t p0 = (int64_t)i * src_len;
+        int64_t p1 = (int64_t)(i + 1) * src_len;
+        int first = p0 / dst_len;
+        int16_t *w = &axis->weights[i * axis->taps];
+        int total = 0, largest = 0;
+
+        // Keep every tap inside the source so the SIMD paths can read pairs without bounds checks
+        if (first > src_len - axis->taps)
+        {
+            first = (src_len - axis->taps < 0) ? 0 : src_len - axis->taps;
+        }
+        axis->start[i] = first;
+
+        for (int k = 0; k < axis->taps && first + k < src_len; k++)
+        {
+            int64_t s0 = (int64_t)(first + k) * dst_len;
+            int64_t s1 = s0 + dst_len;
+            int64_t overlap = ((s1 < p1) ? s1 : p1) - ((s0 > p0) ? s0 : p0);
+            if (overlap <= 0)
+            {
+                continue;
+            }
+            w[k] = (int16_t)((overlap * RESAMPLE_ONE) / src_len);
+            total += w[k];
+            largest = (w[k] > w[largest]) ? k : largest;
+        }
+        // Put rounding error on the heaviest tap so a flat colour stays exactly flat
+        w[largest] += RESAMPLE_ONE - total;
+    }
+    return true;
+}
+
+static void resample_axis_free(resample_axis_t *axis)
+{
+    free(axis->start);
+    free(axis->weights);
+}
+
+static inline uint8_t resample_clamp(int32_t v)
+{
+    v = (v + RESAMPLE_ROUND) >> RESAMPLE_SHIFT;
+    return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+// Horizontal pass. src is src_w x rows, dst is dst_w x rows. 4 bytes per pixel.
+static void resample_h_bgra(const uint8_t *src, int src_w, uint8_t *dst, int dst_w, int rows, const resample_axis_t *ax)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        const uint8_t *s = &src[y * src_w * 4];
+        uint8_t *d = &dst[y * dst_w * 4];
+        for (int x = 0; x < dst_w; x++)
+        {
+            const uint8_t *sp = &s[ax->start[x] * 4];
+            const int16_t *w = &ax->weights[x * ax->taps];
+#if defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            __m128i acc = _mm_setzero_si128();
+            for (int k = 0; k < ax->taps; k += 2)
+            {
+                int32_t p0, p1;
+                memcpy(&p0, &sp[k * 4], 4);
+                memcpy(&p1, &sp[k * 4 + 4], 4);
+                // Interleave two pixels so each 32bit lane of madd is one channel: b0*w0 + b1*w1 etc
+                __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p0), _mm_cvtsi32_si128(p1));
+                px = _mm_unpacklo_epi8(px, zero);
+                __m128i wt = _mm_set1_epi32(((uint16_t)w[k + 1] << 16) | (uint16_t)w[k]);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(px, wt));
+            }
+            acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(RESAMPLE_ROUND)), RESAMPLE_SHIFT);
+            acc = _mm_packs_epi32(acc, acc);
+            acc = _mm_packus_epi16(acc, acc);
+            int32_t out = _mm_cvtsi128_si32(acc);
+            memcpy(&d[x * 4], &out, 4);
+#else
+            int32_t acc[4] = {0, 0, 0, 0};
+            for (int k = 0; k < ax->taps; k++)
+            {
+                if (w[k] == 0) continue;
+                acc[0] += sp[k * 4 + 0] * w[k];
+                acc[1] += sp[k * 4 + 1] * w[k];
+                acc[2] += sp[k * 4 + 2] * w[k];
+                acc[3] += sp[k * 4 + 3] * w[k];
+            }
+            d[x * 4 + 0] = resample_clamp(acc[0]);
+            d[x * 4 + 1] = resample_clamp(acc[1]);
+            d[x * 4 + 2] = resample_clamp(acc[2]);
+            d[x * 4 + 3] = resample_clamp(acc[3]);
+#endif
+        }
+    }
+}
+
+// Vertical pass. src is w x src_h, dst is w x dst_h. 4 bytes per pixel.
+static void resample_v_bgra(const uint8_t *src, uint8_t *dst, int w, int dst_h, const resample_axis_t *ay)
+{
+    const int stride = w * 4;
+    for (int y = 0; y < dst_h; y++)
+    {
+        const uint8_t *s = &src[ay->start[y] * stride];
+        const int16_t *wt = &ay->weights[y * ay->taps];
+        uint8_t *d = &dst[y * stride];
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi32(RESAMPLE_ROUND);
+        for (; x + 16 <= stride; x += 16)
+        {
+            __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+            __m128i acc2 = _mm_setzero_si128(), acc3 = _mm_setzero_si128();
+            for (int k = 0; k < ay->taps; k += 2)
+            {
+                // Interleave two source rows so madd produces rowA*wA + rowB*wB per byte
+                __m128i a = _mm_loadu_si128((const __m128i *)&s[k * stride + x]);
+                __m128i b = _mm_loadu_si128((const __m128i *)&s[(k + 1) * stride + x]);
+                __m128i w2 = _mm_set1_epi32(((uint16_t)wt[k + 1] << 16) | (uint16_t)wt[k]);
+                __m128i lo = _mm_unpacklo_epi8(a, b);
+                __m128i hi = _mm_unpackhi_epi8(a, b);
+                acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w2));
+                acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w2));
+                acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w2));
+                acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w2));
+            }
+            acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, round), RESAMPLE_SHIFT);
+            acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, round), RESAMPLE_SHIFT);
+            acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, round), RESAMPLE_SHIFT);
+            acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, round), RESAMPLE_SHIFT);
+            __m128i out = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+            _mm_storeu_si128((__m128i *)&d[x], out);
+        }
+#endif
+        for (; x < stride; x++)
+        {
+            int32_t acc = 0;
+            for (int k = 0; k < ay->taps; k++)
+            {
+                acc += s[k * stride + x] * wt[k];
+            }
+            d[x] = resample_clamp(acc);
+        }
+    }
+}
+
+static void bgra_to_rgb565(const uint8_t *src, uint16_t *dst, int pixels)
+{
+    for (int i = 0; i < pixels; i++)
+    {
+        const uint8_t *px = &src[i * 4];
+        dst[i] = ((px[2] & 0xF8) << 8) | ((px[1] & 0xFC) << 3) | (px[0] >> 3);
+    }
+}
+
+static inline uint16_t pack_rgb565(const int *bgr)
+{
+    return ((bgr[2] & 0xF8) << 8) | ((bgr[1] & 0xFC) << 3) | (bgr[0] >> 3);
+}
+
+// Expand to 8 bits per channel the same way a DXT1 decoder will
+static inline void unpack_rgb565(uint16_t c, int *bgr)
+{
+    int b = c & 0x1F, g = (c >> 5) & 0x3F, r = c >> 11;
+    bgr[0] = (b << 3) | (b >> 2);
+    bgr[1] = (g << 2) | (g >> 4);
+    bgr[2] = (r << 3) | (r >> 2);
+}
+
+// Encode 16 BGRA pixels to one DXT1 block. The end points are opposite corners of the colour bounding box, inset
+// slightly, picking the diagonal that follows how red and blue vary with green across the block. This is much
+// quicker than searching for the best fit and is good enough for thumbnails.
+static void dxt1_encode_block(const uint8_t *px, uint8_t *out)
+{
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    int palette[4][3];
+    int centre[3], cov_rg = 0, cov_bg = 0;
+    uint16_t c0, c1;
+    uint32_t indices = 0;
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = SDL_min(lo[c], px[i * 4 + c]);
+            hi[c] = SDL_max(hi[c], px[i * 4 + c]);
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+        centre[c] = (lo[c] + hi[c]) / 2;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int dg = px[i * 4 + 1] - centre[1];
+        cov_bg += (px[i * 4 + 0] - centre[0]) * dg;
+        cov_rg += (px[i * 4 + 2] - centre[2]) * dg;
+    }
+    if (cov_bg < 0)
+    {
+        int t = lo[0]; lo[0] = hi[0]; hi[0] = t;
+    }
+    if (cov_rg < 0)
+    {
+        int t = lo[2]; lo[2] = hi[2]; hi[2] = t;
+    }
+
+    // c0 > c1 selects the four colour mode. If they are equal the block is a single colour and every index is 0.
+    c0 = pack_rgb565(hi);
+    c1 = pack_rgb565(lo);
+    if (c0 < c1)
+    {
+        uint16_t t = c0; c0 = c1; c1 = t;
+    }
+    if (c0 != c1)
+    {
+        unpack_rgb565(c0, palette[0]);
+        unpack_rgb565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 15; i >= 0; i--)
+        {
+            int best = 0, best_dist = SDL_MAX_SINT32;
+            for (int p = 0; p < 4; p++)
+            {
+                int db = px[i * 4 + 0] - palette[p][0];
+                int dg = px[i * 4 + 1] - palette[p][1];
+                int dr = px[i * 4 + 2] - palette[p][2];
+                int dist = db * db + dg * dg + dr * dr;
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = p;
+                }
+            }
+            indices = (indices << 2) | best;
+        }
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = indices >> 24;
+}
+
+static void bgra_to_dxt1(const uint8_t *src, uint8_t *dst, int w, int h)
+{
+    uint8_t block[16 * 4];
+    for (int by = 0; by < h; by += 4)
+    {
+        for (int bx = 0; bx < w; bx += 4)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                const uint8_t *row = &src[SDL_min(by + y, h - 1) * w * 4];
+                for (int x = 0; x < 4; x++)
+                {
+                    memcpy(&block[(y * 4 + x) * 4], &row[SDL_min(bx + x, w - 1) * 4], 4);
+                }
+            }
+            dxt1_encode_block(block, dst);
+            dst += 8;
+        }
+    }
+}
+
+// Area resample a BGRA image to exactly dst_w x dst_h. dst is in jpeg_colour_depth format.
+static bool resample_image(const uint8_t *src, int src_w, int src_h, uint8_t *dst, int dst_w, int dst_h)
+{
+    resample_axis_t ax, ay;
+    bool ok = false;
+    uint8_t *tmp_h = NULL, *tmp_v = NULL;
+
+    // Every output pixel reads source pixels in pairs
+    if (src_w < 2 || src_h < 2)
+    {
+        return false;
+    }
+
+    if (resample_axis_init(&ax, src_w, dst_w) == false)
+    {
+        return false;
+    }
+    if (resample_axis_init(&ay, src_h, dst_h) == false)
+    {
+        resample_axis_free(&ax);
+        return false;
+    }
+
+    tmp_h = malloc(dst_w * src_h * 4);
+    tmp_v = (jpeg_colour_depth == 32) ? dst : malloc(dst_w * dst_h * 4);
+    if (tmp_h != NULL && tmp_v != NULL)
+    {
+        resample_h_bgra(src, src_w, tmp_h, dst_w, src_h, &ax);
+        resample_v_bgra(tmp_h, tmp_v, dst_w, dst_h, &ay);
+        if (jpeg_colour_depth == 16)
+        {
+            bgra_to_rgb565(tmp_v, (uint16_t *)dst, dst_w * dst_h);
+        }
+        else if (jpeg_colour_depth == JPEG_DECODER_DXT1)
+        {
+            bgra_to_dxt1(tmp_v, dst, dst_w, dst_h);
+        }
+        ok = true;
+    }
+
+    free(tmp_h);
+    if (tmp_v != dst)
+    {
+        free(tmp_v);
+    }
+    resample_axis_free(&ax);
+    resample_axis_free(&ay);
+    return ok;
+}
+
+// Give back a job's file buffer so the IO thread can read the next file
+static void io_buffer_release(jpeg_t *jpeg)
+{
+    if (jpeg->io_buffer < 0)
+    {
+        return;
+    }
+    SDL_LockMutex(jpegdecomp_qmutex);
+    jpeg_io_buffer_used[jpeg->io_buffer] = false;
+    jpeg->io_buffer = -1;
+    SDL_UnlockMutex(jpegdecomp_qmutex);
+    SDL_SemPost(jpeg_io_buffers_free);
+    SDL_SemPost(jpeg_io_wake);
+}
+
+// Return a job to the mempool and give back its file buffer. Any handles to it are stale from here on.
+static void jpeg_release(jpeg_t *jpeg)
+{
+    io_buffer_release(jpeg);
+    uint32_t generation = JOB_GENERATION(SDL_AtomicGet(&jpeg->state));
+    generation = (generation >= JOB_GENERATION_MAX) ? 1 : generation + 1;
+    SDL_AtomicSet(&jpeg->state, JOB_TAG(generation, STATE_FREE));
+    ring_push(&jpeg_mpool_free, (int)(jpeg - jpeg_mpool));
+}
+
+// Must be called with jpegdecomp_qmutex held.
+static void ready_remove(jpeg_t *jpeg)
+{
+    int index = jpeg->ready_index;
+    jpeg_t *last = jpegdecomp_ready[--jpegdecomp_ready_count];
+    jpegdecomp_ready[index] = last;
+    last->ready_index = index;
+    jpeg->ready_index = -1;
+}
+
+// Put newly queued jobs in the heap, re-rank jobs whose priority changed and drop aborted ones.
+static void io_take_submitted(void)
+{
+    int index;
+    while (ring_pop(&jpegdecomp_submitted, &index))
+    {
+        jpeg_t *jpeg = &jpeg_mpool[index];
+        SDL_AtomicSet(&jpeg->pending, 0);
+        jpeg_location_t location = SDL_AtomicGet(&jpeg->location);
+        if (location == LOCATION_PIPELINE)
+        {
+            // A job that was read but not picked up by a decode worker yet is still holding a file buffer.
+            // The count it left on jpegdecomp_ready_sem only wakes a worker that finds nothing to do.
+            bool ready = false;
+            if (job_aborted(jpeg))
+            {
+                SDL_LockMutex(jpegdecomp_qmutex);
+                ready = (jpeg->ready_index >= 0);
+                if (ready)
+                {
+                    ready_remove(jpeg);
+                }
+                SDL_UnlockMutex(jpegdecomp_qmutex);
+            }
+            if (ready)
+            {
+                jpeg_release(jpeg);
+            }
+            continue;
+        }
+        if (job_aborted(jpeg))
+        {
+            if (location == LOCATION_HEAP)
+            {
+                heap_remove(jpeg);
+            }
+            jpeg_release(jpeg);
+            continue;
+        }
+        jpeg->heap_priority = SDL_AtomicGet(&jpeg->priority);
+        if (location == LOCATION_SUBMITTED)
+        {
+            SDL_AtomicSet(&jpeg->location, LOCATION_HEAP);
+            heap_push(jpeg);
+        }
+        else
+        {
+            heap_sift_up(jpeg->heap_index);
+            heap_sift_down(jpeg->heap_index);
+        }
+    }
+}
+
+// First stage of the pipeline. Reads each queued file, most important first, into a pooled buffer so the decode
+// workers never wait on the disk and the disk is reading the next file while the current one is decoded.
+static int io_thread(void *ptr)
+{
+    (void)ptr;
     FILE *jfile;
     jpeg_t *jpeg;
+    long file_len;
+    int buffer;
+
+    while (1)
+    {
+        SDL_SemWait(jpeg_io_wake);
+
+        if (jpeg_decoder_running == 0)
+        {
+            return 0;
+        }
+
+        io_take_submitted();
+
+        // The job is only taken once a buffer is free so it is the most important job at the time the read can
+        // actually start. If there is no buffer we are woken again when one is given back.
+        while (jpeg_decoder_running && jpegdecomp_heap_size > 0 && SDL_SemTryWait(jpeg_io_buffers_free) == 0)
+        {
+            jpeg = jpegdecomp_heap[0];
+            heap_remove(jpeg);
+            SDL_AtomicSet(&jpeg->location, LOCATION_PIPELINE);
+
+            SDL_LockMutex(jpegdecomp_qmutex);
+            for (buffer = 0; jpeg_io_buffer_used[buffer]; buffer++)
+                ;
+            jpeg_io_buffer_used[buffer] = true;
+            jpeg->io_buffer = buffer;
+            SDL_UnlockMutex(jpegdecomp_qmutex);
+
+            if (job_aborted(jpeg))
+            {
+                goto leave_error;
+            }
+
+            // See if the user has this image cached already. If so we can skip the decode entirely
+            if (jpeg_cache_load != NULL && jpeg->cache_checked == false)
+            {
+                jpeg->cache_checked = true;
+                jpeg->mem = image_alloc();
+                if (jpeg->mem == NULL)
+                {
+                    goto leave_failed;
+                }
+                jpeg->decompressed_image = image_from_mem(jpeg->mem);
+                if (jpeg_cache_load(jpeg->fn, jpeg->decompressed_image, jpeg_out_width, jpeg_out_height, jpeg_colour_depth))
+                {
+                    if (job_begin_callback(jpeg))
+                    {
+                        jpeg->complete_cb(jpeg->decompressed_image, jpeg->mem, jpeg_out_width, jpeg_out_height, jpeg->user_data);
+                    }
+                    else
+                    {
+                        jpeg_decoder_free_image(jpeg->mem);
+                    }
+                    goto leave_error;
+                }
+                jpeg_decoder_free_image(jpeg->mem);
+                jpeg->mem = NULL;
+            }
+
+            // Read the whole file in one go
+            jfile = fopen(jpeg->fn, "rb");
+            if (jfile == NULL)
+            {
+                printf("Could not open %s\n", jpeg->fn);
+                goto leave_failed;
+            }
+            fseek(jfile, 0, SEEK_END);
+            file_len = ftell(jfile);
+            fseek(jfile, 0, SEEK_SET);
+            if (file_len <= 0)
+            {
+                fclose(jfile);
+                goto leave_failed;
+            }
+            if ((size_t)file_len > jpeg_io_buffer_size[buffer])
+            {
+                uint8_t *new_buffer = realloc(jpeg_io_buffers[buffer], file_len);
+                if (new_buffer == NULL)
+                {
+                    fclose(jfile);
+                    goto leave_failed;
+                }
+                jpeg_io_buffers[buffer] = new_buffer;
+                jpeg_io_buffer_size[buffer] = file_len;
+            }
+            jpeg->file_len = fread(jpeg_io_buffers[buffer], 1, file_len, jfile);
+            fclose(jfile);
+            if (jpeg->file_len != (size_t)file_len)
+            {
+                printf("Could not read %s\n", jpeg->fn);
+                goto leave_failed;
+            }
+
+            // Hand the file over to the decode workers
+            SDL_LockMutex(jpegdecomp_qmutex);
+            jpeg->ready_index = jpegdecomp_ready_count;
+            jpegdecomp_ready[jpegdecomp_ready_count++] = jpeg;
+            SDL_UnlockMutex(jpegdecomp_qmutex);
+            SDL_SemPost(jpegdecomp_ready_sem);
+            goto next_job;
+
+        leave_failed:
+            if (job_begin_callback(jpeg))
+            {
+                jpeg->complete_cb(NULL, NULL, 0, 0, jpeg->user_data);
+            }
+        leave_error:
+            // We have finished with the object, return it to the mempool.
+            jpeg_release(jpeg);
+        next_job:
+            // Pick up anything queued or re-ranked while the file was read
+            io_take_submitted();
+        }
+    }
+    return 0;
+}
+
+// Decode at 1/8 scale, which only needs the DC coefficient of each block so it is much quicker than the real decode,
+// then stretch it to the output size. The result is a blurred placeholder that is passed to jpeg_preview_cb.
+static void decode_preview(jpeg_t *jpeg, struct jpeg_decompress_struct *jinfo)
+{
+    jinfo->scale_num = 1;
+    jinfo->scale_denom = 8;
+    jinfo->out_color_space = JCS_EXT_BGRA;
+    jinfo->do_fancy_upsampling = FALSE;
+    jinfo->do_block_smoothing = FALSE;
+    jinfo->two_pass_quantize = FALSE;
+    jinfo->dct_method = JDCT_FASTEST;
+    jinfo->dither_mode = JDITHER_NONE;
+    jpeg_start_decompress(jinfo);
+
+    // The buffers are kept in the job so they are freed if libjpeg jumps back to the worker with an error
+    int row_stride = jinfo->output_width * 4;
+    jpeg->scratch = malloc(jinfo->output_height * row_stride);
+    jpeg->mem = image_alloc();
+    if (jpeg->scratch != NULL && jpeg->mem != NULL)
+    {
+        while (jinfo->output_scanline < jinfo->output_height)
+        {
+            JSAMPROW row = &jpeg->scratch[jinfo->output_scanline * row_stride];
+            jpeg_read_scanlines(jinfo, &row, 1);
+        }
+        uint8_t *image = image_from_mem(jpeg->mem);
+        if (resample_image(jpeg->scratch, jinfo->output_width, jinfo->output_height,
+                           image, jpeg_out_width, jpeg_out_height) &&
+            job_begin_callback(jpeg))
+        {
+            jpeg_preview_cb(image, jpeg->mem, jpeg_out_width, jpeg_out_height, jpeg->user_data);
+            job_end_callback(jpeg);
+            jpeg->mem = NULL; // Belongs to the user now
+        }
+    }
+    free(jpeg->scratch);
+    jpeg->scratch = NULL;
+    jpeg_decoder_free_image(jpeg->mem);
+    jpeg->mem = NULL;
+}
+
+// Second stage of the pipeline. Decodes files that are already in memory.
+static int decomp_thread(void *ptr)
+{
+    (void)ptr;
+    jpeg_t *jpeg;
     struct jpeg_decompress_struct jinfo;
     struct jpeg_decoder_error_mgr jerr;
     JSAMPARRAY line_buffer;
     int row_stride;
     void *old_line_buffer;
-    jpeg_image_state_t state;
+    uint8_t *scaled_image;
+    bool needs_resample;
+
+    // Decoding is background work. Let the UI thread preempt us instead of sleeping for a fixed time.
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
 
     while (1)
     {
-        // Wait for a jpeg item to be in the decomp queue.
-        SDL_SemWait(jpegdecomp_queue);
+        // Wait for a file to be read into memory.
+        SDL_SemWait(jpegdecomp_ready_sem);
 
         if (jpeg_decoder_running == 0)
         {
             return 0;
         }
-        jpeg = jpegdecomp_qhead;
 
-        state = SDL_AtomicGet(&jpeg->state);
-        if (state == STATE_DECOMP_ABORTED)
+        // Take the most important file that is ready. Other workers may be decoding at the same time
+        // so the job is removed here rather than when it completes.
+        SDL_LockMutex(jpegdecomp_qmutex);
+        jpeg = NULL;
+        int best_priority = 0;
+        for (int i = 0; i < jpegdecomp_ready_count; i++)
         {
-            goto leave_error;
+            int priority = SDL_AtomicGet(&jpegdecomp_ready[i]->priority);
+            if (jpeg == NULL || job_before(jpegdecomp_ready[i], priority, jpeg, best_priority))
+            {
+                jpeg = jpegdecomp_ready[i];
+                best_priority = priority;
+            }
+        }
+        if (jpeg != NULL)
+        {
+            ready_remove(jpeg);
+        }
+        SDL_UnlockMutex(jpegdecomp_qmutex);
+
+        // The IO thread may have taken back an aborted job after its count was posted
+        if (jpeg == NULL)
+        {
+            continue;
         }
 
-        jfile = fopen(jpeg->fn, "rb");
-        if (jfile == NULL)
+        if (job_aborted(jpeg))
         {
-            printf("Could not open %s\n", jpeg->fn);
             goto leave_error;
         }
 
@@ -108,55 +1139,96 @@ static int decomp_thread(void *ptr)
 
         if (setjmp(jerr.setjmp_buffer)) {
             jpeg_destroy_decompress(&jinfo);
-            fclose(jfile);
-            goto leave_error;
+            // libjpeg jumped out of the middle of the decode. Free whatever it was decoding into
+            jpeg_decoder_free_image(jpeg->mem);
+            jpeg->mem = NULL;
+            jpeg->decompressed_image = NULL;
+            free(jpeg->scratch);
+            jpeg->scratch = NULL;
+            goto leave_failed;
         }
 
-        jpeg_stdio_src(&jinfo, jfile);
+        jpeg_mem_src(&jinfo, jpeg_io_buffers[jpeg->io_buffer], jpeg->file_len);
         if (jpeg_read_header(&jinfo, TRUE) != JPEG_HEADER_OK)
         {
             printf("Invalid jpeg file at %s\n", jpeg->fn);
             jpeg_destroy_decompress(&jinfo);
-            fclose(jfile);
-            goto leave_error;
+            goto leave_failed;
         }
-        jinfo.out_color_space = (jpeg_colour_depth == 16) ? JCS_RGB565 : JCS_EXT_BGRA;
-
-        int max_size;
-        jinfo.scale_num = 9;
+        // Find the smallest DCT scale that is still at least as large as the output in both dimensions.
+        // The DCT scaling is almost free, then the area resampler does the rest.
+        jinfo.scale_num = 0;
         jinfo.scale_denom = 8;
         do
         {
-            jinfo.scale_num--;
+            jinfo.scale_num++;
             jpeg_calc_output_dimensions(&jinfo);
-            max_size = (jinfo.output_width < jinfo.output_height) ? jinfo.output_height : jinfo.output_width;
-            if (jinfo.scale_num == 1)
+        } while (jinfo.scale_num < 8 &&
+                 ((int)jinfo.output_width < jpeg_out_width || (int)jinfo.output_height < jpeg_out_height));
+
+        // Make the preview first, then put the job back in the queue for the full decode. Not worth it if the
+        // full decode is at 1/8 scale anyway.
+        if (jpeg->preview_done == false && jinfo.scale_num > 1)
+        {
+            decode_preview(jpeg, &jinfo);
+            jpeg_destroy_decompress(&jinfo);
+
+            // Give the file buffer back so the other previews are not held up. The file is read again
+            // when this job comes back round for the full decode.
+            io_buffer_release(jpeg);
+            jpeg->preview_done = true;
+            if (job_aborted(jpeg))
             {
-                break;
+                jpeg_release(jpeg);
+            }
+            else
+            {
+                SDL_AtomicSet(&jpeg->location, LOCATION_SUBMITTED);
+                job_notify(jpeg);
             }
-        } while (max_size > jpeg_max_dimension);
+            continue;
+        }
+        jpeg->preview_done = true;
+
+        // If the DCT scale happened to land on the exact size we can decode straight into the output format,
+        // otherwise decode to BGRA for the resampler. DXT1 is always encoded from the resampler output.
+        needs_resample = ((int)jinfo.output_width != jpeg_out_width || (int)jinfo.output_height != jpeg_out_height ||
+                          jpeg_colour_depth == JPEG_DECODER_DXT1);
+        jinfo.out_color_space = (jpeg_colour_depth == 16 && needs_resample == false) ? JCS_RGB565 : JCS_EXT_BGRA;
         jinfo.do_fancy_upsampling = FALSE;
         jinfo.do_block_smoothing = FALSE;
         jinfo.two_pass_quantize = FALSE;
         jinfo.dct_method = JDCT_FASTEST;
         jinfo.dither_mode = JDITHER_NONE;
         jpeg_start_decompress(&jinfo);
-        jinfo.output_components = jpeg_colour_depth / 8;
+        jinfo.output_components = (jinfo.out_color_space == JCS_RGB565) ? 2 : 4;
         row_stride = jinfo.output_width * jinfo.output_components;
         line_buffer = (*jinfo.mem->alloc_sarray)((j_common_ptr)&jinfo, JPOOL_IMAGE, row_stride, 1);
 
         old_line_buffer = line_buffer[0]; // Save the original allocation
 
-        jpeg->mem = malloc(jinfo.output_width * jinfo.output_height * (jpeg_colour_depth / 8) + 16);
-        //Get a 16 byte aligned pointer to return to the user
-        jpeg->decompressed_image = align_pointer(jpeg->mem, 16);
+        jpeg->mem = image_alloc();
+        jpeg->decompressed_image = (jpeg->mem) ? image_from_mem(jpeg->mem) : NULL;
+
+        scaled_image = jpeg->decompressed_image;
+        if (needs_resample && jpeg->decompressed_image)
+        {
+            jpeg->scratch = malloc(jinfo.output_height * row_stride + 16);
+            scaled_image = (jpeg->scratch) ? align_pointer(jpeg->scratch, 16) : NULL;
+            if (scaled_image == NULL)
+            {
+                jpeg_decoder_free_image(jpeg->mem);
+                jpeg->mem = NULL;
+                jpeg->decompressed_image = NULL;
+            }
+        }
 
         while (jinfo.output_scanline < jinfo.output_height)
         {
-            state = SDL_AtomicGet(&jpeg->state);
-            if (state == STATE_DECOMP_ABORTED)
+            if (job_aborted(jpeg) && jpeg->decompressed_image)
             {
-                free(jpeg->mem);
+                jpeg_decoder_free_image(jpeg->mem);
+                jpeg->mem = NULL;
                 jpeg->decompressed_image = NULL;
             }
 
@@ -166,37 +1238,66 @@ static int decomp_thread(void *ptr)
             }
 
             // Save a memcpy and put our buffer directly into JSAMPARRAY
-            line_buffer[0] = (void *)&jpeg->decompressed_image[jinfo.output_scanline * row_stride];
+            line_buffer[0] = (void *)&scaled_image[jinfo.output_scanline * row_stride];
             jpeg_read_scanlines(&jinfo, line_buffer, 1);
 
-            if (jinfo.output_scanline % 100 == 0)
+            // Give up the rest of our timeslice now and then so equal priority threads get a turn.
+            if (jinfo.output_scanline % JPEG_DECODER_YIELD_LINES == 0)
             {
-                SDL_Delay(20);
+                SDL_Delay(0);
             }
         }
 
         line_buffer[0] = old_line_buffer; // Restore original allocation so it gets cleared
         jpeg_destroy_decompress(&jinfo);
-        fclose(jfile);
 
-        jpeg->complete_cb(jpeg->decompressed_image, jpeg->mem, jinfo.output_width, jinfo.output_height, jpeg->user_data);
+        // Done with the compressed file. Give the buffer back so the IO thread can read the next one
+        io_buffer_release(jpeg);
 
-    leave_error:
-        // We have finished with the object, remove it from the queue.
-        SDL_LockMutex(jpegdecomp_qmutex);
-        if (jpegdecomp_qhead != NULL)
+        if (needs_resample && jpeg->decompressed_image)
+        {
+            if (resample_image(scaled_image, jinfo.output_width, jinfo.output_height,
+                               jpeg->decompressed_image, jpeg_out_width, jpeg_out_height) == false)
+            {
+                jpeg_decoder_free_image(jpeg->mem);
+                jpeg->mem = NULL;
+                jpeg->decompressed_image = NULL;
+            }
+        }
+        free(jpeg->scratch);
+        jpeg->scratch = NULL;
+
+        if (jpeg_cache_store != NULL && jpeg->decompressed_image != NULL)
         {
-            jpegdecomp_qhead = jpegdecomp_qhead->next;
+            jpeg_cache_store(jpeg->fn, jpeg->decompressed_image, jpeg_out_width, jpeg_out_height, jpeg_colour_depth);
         }
-        SDL_AtomicSet(&jpeg->state, STATE_FREE);
-        SDL_UnlockMutex(jpegdecomp_qmutex);
+
+        if (job_begin_callback(jpeg))
+        {
+            jpeg->complete_cb(jpeg->decompressed_image, jpeg->mem, jpeg_out_width, jpeg_out_height, jpeg->user_data);
+        }
+        else if (jpeg->decompressed_image != NULL)
+        {
+            jpeg_decoder_free_image(jpeg->mem);
+        }
+        goto leave_error;
+
+    leave_failed:
+        if (job_begin_callback(jpeg))
+        {
+            jpeg->complete_cb(NULL, NULL, 0, 0, jpeg->user_data);
+        }
+    leave_error:
+        // We have finished with the object, return it to the mempool.
+        jpeg_release(jpeg);
     }
     return 0;
 }
 
-void jpeg_decoder_init(int colour_depth, int max_dimension)
+void jpeg_decoder_init(int colour_depth, int out_width, int out_height, int num_threads)
 {
-    assert(colour_depth == 16 || colour_depth == 32);
+    assert(colour_depth == 16 || colour_depth == 32 || colour_depth == JPEG_DECODER_DXT1);
+    assert(out_width > 0 && out_height > 0);
 
     if (jpeg_decoder_running == 1)
     {
@@ -206,92 +1307,229 @@ void jpeg_decoder_init(int colour_depth, int max_dimension)
 
     memset(jpeg_mpool, 0, sizeof(jpeg_mpool));
     jpeg_colour_depth = colour_depth;
-    jpeg_max_dimension = max_dimension;
-    jpegdecomp_qhead = NULL;
-    jpegdecomp_qtail = NULL;
-    jpeg_mpool_free = &jpeg_mpool[0];
+    jpeg_out_width = out_width;
+    jpeg_out_height = out_height;
+    jpeg_image_size = JPEG_DECODER_IMAGE_SIZE(out_width, out_height, colour_depth);
+    if (jpeg_image_mutex == NULL)
+    {
+        jpeg_image_mutex = SDL_CreateMutex();
+        assert(jpeg_image_mutex != NULL);
+        jpeg_image_slot_size = JPEG_DECODER_IMAGE_ALIGN + jpeg_image_size;
+        jpeg_image_slot_size = (jpeg_image_slot_size + JPEG_DECODER_IMAGE_ALIGN - 1) & ~(JPEG_DECODER_IMAGE_ALIGN - 1);
+    }
+    // Images of a different size can not use the pool
+    if (jpeg_image_slot_size < JPEG_DECODER_IMAGE_ALIGN + jpeg_image_size)
+    {
+        jpeg_image_max_slots = 0;
+    }
+    ring_init(&jpeg_mpool_free);
+    ring_init(&jpegdecomp_submitted);
+    for (int i = 0; i < JPEG_DECODER_QUEUE_SIZE; i++)
+    {
+        jpeg_mpool[i].heap_index = -1;
+        jpeg_mpool[i].ready_index = -1;
+        jpeg_mpool[i].io_buffer = -1;
+        SDL_AtomicSet(&jpeg_mpool[i].state, JOB_TAG(1, STATE_FREE));
+        ring_push(&jpeg_mpool_free, i);
+    }
+    jpegdecomp_heap_size = 0;
+    jpegdecomp_ready_count = 0;
+    SDL_AtomicSet(&jpegdecomp_sequence, 0);
+
+    if (num_threads <= 0)
+    {
+        num_threads = SDL_GetCPUCount();
+    }
+    num_threads = (num_threads < 1) ? 1 : num_threads;
+    num_threads = (num_threads > JPEG_DECODER_MAX_THREADS) ? JPEG_DECODER_MAX_THREADS : num_threads;
+
+    // Enough buffers for every worker to have a file, and the IO thread to be reading the next one
+    jpeg_io_num_buffers = num_threads + 2;
+    jpeg_io_num_buffers = (jpeg_io_num_buffers > JPEG_DECODER_MAX_IO_BUFFERS) ? JPEG_DECODER_MAX_IO_BUFFERS : jpeg_io_num_buffers;
+    memset(jpeg_io_buffers, 0, sizeof(jpeg_io_buffers));
+    memset(jpeg_io_buffer_size, 0, sizeof(jpeg_io_buffer_size));
+    memset(jpeg_io_buffer_used, 0, sizeof(jpeg_io_buffer_used));
+
     jpegdecomp_qmutex = SDL_CreateMutex();
-    jpegdecomp_queue = SDL_CreateSemaphore(0);
-    jpegdecomp_thread = SDL_CreateThread(decomp_thread, "jpegdecomp_thread", (void *)NULL);
+    jpeg_io_wake = SDL_CreateSemaphore(0);
+    jpegdecomp_ready_sem = SDL_CreateSemaphore(0);
+    jpeg_io_buffers_free = SDL_CreateSemaphore(jpeg_io_num_buffers);
 
     assert(jpegdecomp_qmutex != NULL);
-    assert(jpegdecomp_thread != NULL);
-    assert(jpegdecomp_queue != NULL);
+    assert(jpeg_io_wake != NULL);
+    assert(jpegdecomp_ready_sem != NULL);
+    assert(jpeg_io_buffers_free != NULL);
+
+    jpeg_io_thread = SDL_CreateThread(io_thread, "jpeg_io_thread", (void *)NULL);
+    assert(jpeg_io_thread != NULL);
+
+    jpegdecomp_num_threads = num_threads;
+    for (int i = 0; i < jpegdecomp_num_threads; i++)
+    {
+        jpegdecomp_threads[i] = SDL_CreateThread(decomp_thread, "jpegdecomp_thread", (void *)NULL);
+        assert(jpegdecomp_threads[i] != NULL);
+    }
 }
 
 void jpeg_decoder_deinit()
 {
     int thread_status;
-    jpeg_decoder_running = 0;      // This will make decomp thread quit on next run
-    SDL_SemPost(jpegdecomp_queue); // Force thread run.
-    SDL_WaitThread(jpegdecomp_thread, &thread_status);
+    jpeg_decoder_running = 0; // This will make decomp threads quit on next run
+    SDL_SemPost(jpeg_io_wake); // Force thread run.
+    SDL_WaitThread(jpeg_io_thread, &thread_status);
+    jpeg_io_thread = NULL;
+    for (int i = 0; i < jpegdecomp_num_threads; i++)
+    {
+        SDL_SemPost(jpegdecomp_ready_sem); // Force thread run.
+    }
+    for (int i = 0; i < jpegdecomp_num_threads; i++)
+    {
+        SDL_WaitThread(jpegdecomp_threads[i], &thread_status);
+        jpegdecomp_threads[i] = NULL;
+    }
+    jpegdecomp_num_threads = 0;
+    for (int i = 0; i < JPEG_DECODER_MAX_IO_BUFFERS; i++)
+    {
+        free(jpeg_io_buffers[i]);
+        jpeg_io_buffers[i] = NULL;
+        jpeg_io_buffer_size[i] = 0;
+    }
     SDL_DestroyMutex(jpegdecomp_qmutex);
-    SDL_DestroySemaphore(jpegdecomp_queue);
+    SDL_DestroySemaphore(jpeg_io_wake);
+    SDL_DestroySemaphore(jpegdecomp_ready_sem);
+    SDL_DestroySemaphore(jpeg_io_buffers_free);
 }
 
-void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data)
+void jpeg_decoder_reserve_images(int count)
 {
+    SDL_LockMutex(jpeg_image_mutex);
+    // Slots are never given back, so the pool can only grow
+    if (jpeg_image_slot_size >= JPEG_DECODER_IMAGE_ALIGN + jpeg_image_size)
+    {
+        jpeg_image_max_slots = SDL_max(jpeg_image_max_slots, count);
+    }
+    SDL_UnlockMutex(jpeg_image_mutex);
+}
 
-    jpeg_t *jpeg = NULL;
-
-    // Allocate a object from local mempool
-    SDL_LockMutex(jpegdecomp_qmutex);
-    if (jpeg_mpool_free != NULL)
+void jpeg_decoder_free_image(void *mem)
+{
+    jpeg_image_hdr_t *slot = mem;
+    if (slot == NULL)
     {
-        // Quick fetch if possible
-        jpeg = jpeg_mpool_free;
-        jpeg_mpool_free = NULL;
+        return;
     }
-    else
+    if (slot->pooled == false)
     {
-        for (int i = 0; i < JPEG_DECODER_QUEUE_SIZE; i++)
-        {
-            jpeg_image_state_t state = SDL_AtomicGet(&jpeg_mpool[i].state);
-            if (state == STATE_FREE)
-            {
-                jpeg = &jpeg_mpool[i];
-                break;
-            }
-        }
+        free(slot);
+        return;
     }
+    SDL_LockMutex(jpeg_image_mutex);
+    slot->next = jpeg_image_free;
+    jpeg_image_free = slot;
+    SDL_UnlockMutex(jpeg_image_mutex);
+}
+
+void jpeg_decoder_set_cache(jpg_cache_load_cb_t load_cb, jpg_cache_store_cb_t store_cb)
+{
+    SDL_LockMutex(jpegdecomp_qmutex);
+    jpeg_cache_load = load_cb;
+    jpeg_cache_store = store_cb;
     SDL_UnlockMutex(jpegdecomp_qmutex);
+}
 
-    if (jpeg == NULL)
+void jpeg_decoder_set_preview(jpg_complete_cb_t preview_cb)
+{
+    SDL_LockMutex(jpegdecomp_qmutex);
+    jpeg_preview_cb = preview_cb;
+    SDL_UnlockMutex(jpegdecomp_qmutex);
+}
+
+void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data, int priority)
+{
+    jpeg_t *jpeg;
+    int index;
+
+    // Allocate a object from local mempool
+    if (ring_pop(&jpeg_mpool_free, &index) == false)
     {
         return NULL;
     }
+    jpeg = &jpeg_mpool[index];
 
     strncpy(jpeg->fn, fn, sizeof(jpeg->fn) - 1);
     jpeg->user_data = user_data;
     jpeg->complete_cb = complete_cb;
-    SDL_AtomicSet(&jpeg->state, STATE_DECOMP_QUEUED);
+    jpeg->mem = NULL;
+    jpeg->decompressed_image = NULL;
+    jpeg->scratch = NULL;
+    jpeg->cache_checked = false;
+    jpeg->preview_done = (jpeg_preview_cb == NULL);
+    jpeg->sequence = SDL_AtomicAdd(&jpegdecomp_sequence, 1);
+    SDL_AtomicSet(&jpeg->priority, priority);
+    SDL_AtomicSet(&jpeg->location, LOCATION_SUBMITTED);
 
-    SDL_LockMutex(jpegdecomp_qmutex);
-    if (jpegdecomp_qhead == NULL)
-    {
-        jpegdecomp_qhead = jpeg;
-        jpegdecomp_qtail = jpegdecomp_qhead;
-        jpegdecomp_qtail->next = NULL;
-    }
-    else
+    uint32_t generation = JOB_GENERATION(SDL_AtomicGet(&jpeg->state));
+    SDL_AtomicSet(&jpeg->state, JOB_TAG(generation, STATE_DECOMP_QUEUED));
+    job_notify(jpeg);
+
+    return job_handle(jpeg, generation);
+}
+
+void jpeg_decoder_set_priority(void *handle, int priority)
+{
+    uint32_t generation;
+    jpeg_t *jpeg = job_from_handle(handle, &generation);
+    // Stale handles and finished jobs are ignored. Once a worker has the job the priority only matters
+    // if it goes back in the queue after its preview.
+    if (jpeg == NULL || SDL_AtomicGet(&jpeg->state) != JOB_TAG(generation, STATE_DECOMP_QUEUED) ||
+        SDL_AtomicGet(&jpeg->priority) == priority)
     {
-        jpegdecomp_qtail->next = jpeg;
-        jpegdecomp_qtail = jpeg;
-        jpegdecomp_qtail->next = NULL;
+        return;
     }
-    SDL_UnlockMutex(jpegdecomp_qmutex);
-    SDL_SemPost(jpegdecomp_queue);
-
-    return jpeg;
+    SDL_AtomicSet(&jpeg->priority, priority);
+    job_notify(jpeg);
 }
 
-void jpeg_decoder_abort(void *handle)
+bool jpeg_decoder_abort(void *handle)
 {
-    SDL_LockMutex(jpegdecomp_qmutex);
-    jpeg_t *jpeg = (jpeg_t *)handle;
-    if (jpeg)
+    uint32_t generation;
+    jpeg_t *jpeg = job_from_handle(handle, &generation);
+    if (jpeg == NULL)
     {
-        SDL_AtomicCAS(&jpeg->state, STATE_DECOMP_QUEUED, STATE_DECOMP_ABORTED);
+        return true;
+    }
+
+    while (1)
+    {
+        int tag = SDL_AtomicGet(&jpeg->state);
+        int new_state;
+        // A different generation means the job finished and its callback has returned
+        if (JOB_GENERATION(tag) != generation)
+        {
+            return true;
+        }
+        switch (JOB_STATE(tag))
+        {
+        case STATE_DECOMP_QUEUED:
+            new_state = STATE_DECOMP_ABORTED;
+            break;
+        case STATE_DECOMP_DELIVERING:
+            new_state = STATE_DECOMP_DELIVERING_ABORTED;
+            break;
+        case STATE_DECOMP_DELIVERING_ABORTED:
+            return false;
+        default:
+            return true;
+        }
+        if (SDL_AtomicCAS(&jpeg->state, tag, JOB_TAG(generation, new_state)))
+        {
+            if (new_state == STATE_DECOMP_ABORTED)
+            {
+                // Let the IO thread drop it from the queue now rather than when it reaches the top
+                job_notify(jpeg);
+                return true;
+            }
+            return false;
+        }
     }
-    SDL_UnlockMutex(jpegdecomp_qmutex);
 }
@@ -8,21 +8,59 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 #ifndef JPEG_DECODER_QUEUE_SIZE
 #define JPEG_DECODER_QUEUE_SIZE 64
 #endif
 
-//jpg Decompression compelte cb. Buffer must be freed with free() when complete.
+#ifndef JPEG_DECODER_MAX_THREADS
+#define JPEG_DECODER_MAX_THREADS 8
+#endif
+
+//Maximum number of whole files held in memory waiting for, or being decoded by, the workers
+#ifndef JPEG_DECODER_MAX_IO_BUFFERS
+#define JPEG_DECODER_MAX_IO_BUFFERS (JPEG_DECODER_MAX_THREADS + 2)
+#endif
+
+//Number of scanlines a worker decodes before yielding its timeslice
+#ifndef JPEG_DECODER_YIELD_LINES
+#define JPEG_DECODER_YIELD_LINES 32
+#endif
+
+//Pass as the colour_depth to get DXT1 (BC1) compressed images. Each 4x4 block of pixels is stored in 8 bytes,
+//blocks in rows from the top left. Partial blocks at the right and bottom edges repeat the last pixel.
+#define JPEG_DECODER_DXT1 4
+
+//Alignment of every decoded image
+#ifndef JPEG_DECODER_IMAGE_ALIGN
+#define JPEG_DECODER_IMAGE_ALIGN 64
+#endif
+
+//Size in bytes of a w x h image at colour_depth
+#define JPEG_DECODER_IMAGE_SIZE(w, h, colour_depth) (((colour_depth) == JPEG_DECODER_DXT1) ? \
+    ((((w) + 3) / 4) * (((h) + 3) / 4) * 8) : ((w) * (h) * ((colour_depth) / 8)))
+
+//jpg Decompression compelte cb. mem must be freed with jpeg_decoder_free_image() when complete.
 typedef void (*jpg_complete_cb_t)(void *img, void *mem, int w, int h, void *user_data);
 
+//Optional cache of already decoded images. Both are called from worker thread context.
+//load_cb should fill img (JPEG_DECODER_IMAGE_SIZE bytes) and return true on a cache hit.
+typedef bool (*jpg_cache_load_cb_t)(const char *fn, void *img, int w, int h, int colour_depth);
+//store_cb is given each freshly decoded image before it is passed to the complete_cb.
+typedef void (*jpg_cache_store_cb_t)(const char *fn, const void *img, int w, int h, int colour_depth);
+
 /**
  * @brief Initialise the jpeg_decoder library. Must be called before use.
- * @param colour_depth 16 or 32 for RGB565 or RGBA8888 output.
- * @param max_dimension The maximum width or height Of the output image. The aspect ratio is maintained.
- * This will downscale an image, but it will not upscale.
+ * @param colour_depth 16 or 32 for RGB565 or RGBA8888 output, or JPEG_DECODER_DXT1 for compressed output.
+ * @param out_width The width of every output image.
+ * @param out_height The height of every output image.
+ * Images are decoded at the smallest DCT scale that covers the output size, then area resampled to
+ * exactly out_width x out_height. The aspect ratio is not maintained.
+ * @param num_threads Number of decode worker threads. <= 0 uses one per CPU core, capped at JPEG_DECODER_MAX_THREADS.
  * @return void
  */
-void jpeg_decoder_init(int colour_depth, int max_dimension);
+void jpeg_decoder_init(int colour_depth, int out_width, int out_height, int num_threads);
 
 /**
  * @brief Deinitialise the jpeg_decoder library
@@ -30,19 +68,62 @@ void jpeg_decoder_init(int colour_depth, int max_dimension);
 void jpeg_decoder_deinit();
 
 /**
- * @brief Queue a jpeg file for asynchronous decompression
+ * @brief Reserve a pool of image buffers so decoded images do not come from the heap. Buffers are allocated as they
+ * are first needed and then reused. Once all of them are in use further images are allocated from the heap.
+ * The pool can only grow.
+ * @param count The number of images to keep in the pool.
+ */
+void jpeg_decoder_reserve_images(int count);
+
+/**
+ * @brief Free the mem of an image passed to a complete_cb or preview_cb. Safe to call from any thread.
+ * @param mem The mem from the callback. May be NULL.
+ */
+void jpeg_decoder_free_image(void *mem);
+
+/**
+ * @brief Register a cache that is checked before a jpeg file is decoded.
+ * @param load_cb Called before opening a jpeg. On a hit the jpeg is not decoded at all. May be NULL.
+ * @param store_cb Called with every newly decoded image so it can be cached. May be NULL.
+ */
+void jpeg_decoder_set_cache(jpg_cache_load_cb_t load_cb, jpg_cache_store_cb_t store_cb);
+
+/**
+ * @brief Request a quick preview of every jpeg before its full decode. Each jpeg is decoded at 1/8 scale and
+ * stretched to the output size, then the full image follows through the complete_cb. Previews of all queued jpegs
+ * are made before any full decode. Jpegs found in the user cache do not get a preview.
+ * @param preview_cb Called from worker thread context with the preview image. Same rules as the complete_cb.
+ * NULL to disable previews.
+ */
+void jpeg_decoder_set_preview(jpg_complete_cb_t preview_cb);
+
+/**
+ * @brief Queue a jpeg file for asynchronous decompression. Never blocks.
  * @param fn The filename of the jpeg file.
- * @param complete_cb The callback function which is called when decompression is complete. Note this is called from thread context.
+ * @param complete_cb The callback function which is called when decompression is complete. Note this is called from
+ * a worker thread context and may be called from several workers at once. img is NULL if the file could not be decoded.
  * @param user_data A user defined variable that is returned with the complete_cb.
+ * @param priority Jobs with a lower value are decoded first. Equal priorities are decoded in the order they were queued.
  * @return A handle for the jpeg job, or NULL on error.
  */
-void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data);
+void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data, int priority);
+
+/**
+ * @brief Change the priority of a queued decompression job without requeuing it. Never blocks.
+ * @param handle The handle returned by jpeg_decoder_queue(). If a worker has already started the job, or the job has
+ * finished, this has no effect.
+ * @param priority The new priority. Lower values are decoded first.
+ */
+void jpeg_decoder_set_priority(void *handle, int priority);
 
 /**
- * @brief Abort a previously queued decompression job.
- * @param handle The handle returned by jpeg_decoder_queue(). If the job is finished, this has no effect.
+ * @brief Abort a previously queued decompression job. Never blocks. No callbacks are started for the job after this.
+ * @param handle The handle returned by jpeg_decoder_queue(). Handles stay safe to use after the job has finished,
+ * even once its slot has been reused by another job.
+ * @return true if no callback for the job is running. false if a callback is running right now, in which case it
+ * is the last one. The user_data must be kept valid until it returns.
  */
-void jpeg_decoder_abort(void *handle);
+bool jpeg_decoder_abort(void *handle);
 
 #ifdef __cplusplus
 }
@@ -29,6 +29,7 @@ int strcasecmp(const char *s1, const char *s2);
 #include "dash_settings.h"
 #include "dash_styles.h"
 #include "dash_synop.h"
+#include "dash_thumbcache.h"
 #include "dash_browser.h"
 
 #include "lvgl_drivers/lv_port_disp.h"
@@ -78,6 +79,14 @@ int strcasecmp(const char *s1, const char *s2);
 #endif
 #endif
 
+#ifndef DASH_THUMBCACHE_PATH
+#ifdef NXDK
+#define DASH_THUMBCACHE_PATH "E:\\UDATA\\LithiumX\\thumbs.cache"
+#else
+#define DASH_THUMBCACHE_PATH "thumbs.cache"
+#endif
+#endif
+
 #ifndef DASH_ROOT_PATH
 #ifdef NXDK
 #define DASH_ROOT_PATH ""
@@ -94,10 +103,38 @@ int strcasecmp(const char *s1, const char *s2);
 #define DASH_MAX_PAGES 8
 #endif
 
+// Pages are built when they are first visited. The pages either side of the current one are built early once
+// there has been no input for this many ms, so they are ready when the user gets there.
+#ifndef DASH_PAGE_BUILD_IDLE_MS
+#define DASH_PAGE_BUILD_IDLE_MS 1000
+#endif
+
+// Pages not visited for this many ms are released to save memory, other than the current page and the ones either
+// side of it. They are built again when visited. 0 keeps every page once it is built.
+#ifndef DASH_PAGE_RELEASE_MS
+#define DASH_PAGE_RELEASE_MS 0
+#endif
+
 #ifndef DASH_MAX_PATHS_PER_PAGE
 #define DASH_MAX_PATHS_PER_PAGE 16
 #endif
 
+// Time in ms for the scroller to glide to a new selection. Moves made while it is still moving retarget the same
+// animation instead of starting another one.
+#ifndef DASH_SCROLL_ANIM_TIME
+#define DASH_SCROLL_ANIM_TIME 150
+#endif
+
+// While up, down or a trigger is held, the number of rows moved per key repeat doubles every
+// DASH_NAV_ACCEL_REPEATS repeats, up to DASH_NAV_ACCEL_MAX_ROWS
+#ifndef DASH_NAV_ACCEL_REPEATS
+#define DASH_NAV_ACCEL_REPEATS 6
+#endif
+
+#ifndef DASH_NAV_ACCEL_MAX_ROWS
+#define DASH_NAV_ACCEL_MAX_ROWS 8
+#endif
+
 #ifndef DASH_MAX_GAMES
 #define DASH_MAX_GAMES 1024 //Per page
 #endif
@@ -114,6 +151,47 @@ int strcasecmp(const char *s1, const char *s2);
 #define DASH_THUMBNAIL_HEIGHT (DASH_THUMBNAIL_WIDTH * 1.4)
 #endif
 
+// Number of threads used to decode thumbnails. 0 uses one per CPU core. The Xbox only has one core.
+#ifndef DASH_THUMBNAIL_DECODE_THREADS
+#ifdef NXDK
+#define DASH_THUMBNAIL_DECODE_THREADS 1
+#else
+#define DASH_THUMBNAIL_DECODE_THREADS 0
+#endif
+#endif
+
+// Number of rows past the edge of the screen to decode thumbnails for in the direction the user is scrolling
+#ifndef DASH_THUMBNAIL_PREFETCH_ROWS
+#define DASH_THUMBNAIL_PREFETCH_ROWS 2
+#endif
+
+// Once there has been no input for this many ms and the current page has finished decoding, the thumbnails on the
+// first screen of the pages either side are decoded too, so changing page lands with the art already shown.
+// They use at most DASH_THUMBNAIL_ADJACENT_PERCENT of the thumbnail memory cache.
+#ifndef DASH_THUMBNAIL_ADJACENT_IDLE_MS
+#define DASH_THUMBNAIL_ADJACENT_IDLE_MS 500
+#endif
+
+#ifndef DASH_THUMBNAIL_ADJACENT_PERCENT
+#define DASH_THUMBNAIL_ADJACENT_PERCENT 25
+#endif
+
+// Keep thumbnails DXT1 compressed in memory and in the disk cache. They use 1/8 of the memory of 32bpp thumbnails
+// at some loss of quality. The Xbox GPU draws them directly, otherwise they are decompressed as they are drawn.
+#ifndef DASH_THUMBNAIL_DXT1
+#ifdef NXDK
+#define DASH_THUMBNAIL_DXT1 1
+#else
+#define DASH_THUMBNAIL_DXT1 0
+#endif
+#endif
+
+// Keep thumbnails as RGB565 in memory and in the disk cache when DXT1 is not used, even if the display is 32bpp.
+// They use half the memory of 32bpp thumbnails and are expanded to the display colour depth as they are drawn.
+#ifndef DASH_THUMBNAIL_RGB565
+#define DASH_THUMBNAIL_RGB565 1
+#endif
+
 #ifndef DASH_DEFAULT_THUMBNAIL
 #define DASH_DEFAULT_THUMBNAIL "default_tbn.jpg" //Root directory if not found in game directory
 #endif
@@ -133,35 +211,88 @@ int strcasecmp(const char *s1, const char *s2);
 #define DASH_PREV_PAGE '<'
 #define DASH_SETTINGS_PAGE 's'
 #define DASH_INFO_PAGE 'i'
+#define DASH_JUMP_INDEX 'j'
+
+typedef struct
+{
+    int db_id;
+    char title[MAX_META_LEN];
+    char *thumb_path; //NULL if the title has no thumbnail
+    uint32_t file_size; //Size and last write time of thumb_path when scanned. Used to key the thumbnail cache
+    uint64_t write_time;
+    bool thumb_failed; //thumb_path could not be decoded. Not tried again until the file changes
+    float rating; //Sort keys. Kept with the title so a page can be resorted without going back to the database
+    char release_date[16];
+    char last_launch[20];
+} title_t;
+
+// The fixed grid a scroller lays its items out on. Every cell is the same size, so the position of the
+// title at any grid position is worked out from its index.
+typedef struct
+{
+    int cols;
+    lv_coord_t cell_w;  // Size of each item container
+    lv_coord_t cell_h;
+    lv_coord_t pitch_x; // Distance from the start of one cell to the next, including the padding between them
+    lv_coord_t pitch_y;
+} scroller_grid_t;
+
+// A run of titles on a page that share the same first letter, year etc for the order the page is sorted in
+typedef struct
+{
+    char label[8];
+    int index; // Grid position of the first title in the bucket
+} scroller_bucket_t;
 
 // There is one 'parser' per 'tile'. The parser asynchronously parses all the path set my the xml and adds
 // eatch item. Each parser contains a image scrolling container 'scroller' to show all the game art etc.
 // Each 'tile' is a child of a tileview object 'pagetiles'. These are swiped left and right to change page.
+// The scroller only has enough item containers to fill the screen plus a margin. They are rebound to
+// different titles as the page scrolls. The scroller is only created once the page is needed.
 typedef struct
 {
     char page_title[32];
+    bool collection;    // The page shows the titles matching a filter instead of the titles in its search paths
     void *db_scan_thread;
+    bool scanning;      // db_scan_thread is still reading titles for the page
+    bool rescan_pending; // A database rescan changed titles on the page. It is read again once nothing is scanning
+    uint32_t last_visit; // lv_tick_get() when the page was last shown
     lv_obj_t *tile;     // The tile in the tileview parent 'pagetiles'
-    lv_obj_t *scroller; // The scroller contains image containers for each item
+    lv_obj_t *scroller; // The scroller contains the item containers that show the titles. NULL until the page is built
+    scroller_grid_t grid;
+    title_t *titles;    // Every title on the page in the order they were read from the database
+    int *order;         // Index into titles of the title at each position in the grid
+    int title_cnt;
+    int title_generation; // Incremented each time titles is replaced
+    int focus_index;    // Grid position of the selected title
+    int focus_id;       // db_id of the selected title, or -1. Kept while the page is released so the selection comes back
+    lv_obj_t **items;   // Pool of item containers. Grid position i is shown by items[i % item_cnt]
+    int item_cnt;
+    scroller_bucket_t *buckets; // Jump index for the page in grid order. Rebuilt when the titles or their order change
+    int bucket_cnt;
 } parse_handle_t;
 
+// Thumbnail state of an item container while it is bound to a title
 typedef struct
 {
-    char *thumb_path;
-    lv_obj_t *canvas;
+    lv_obj_t *image_container; //The item this thumbnail belongs to. NULL once the item is unbound while a callback is pending
     void *decomp_handle;
-    void *mem; //Memory is the allocated block from malloc
-    void *image; //image is the decompressed image with mem (this may be byte aligned etc)
+    void *image; //image is the decompressed image. Owned by the thumbnail memory cache
+    void *preview_mem; //Blurred preview shown until the full image is ready. Free with jpeg_decoder_free_image()
     int w;
     int h;
+    dash_thumbcache_user_t cache_user;
 } jpg_info_t;
 
+// The user_data of each pooled item container
 typedef struct
 {
-    int db_id;
-    char title[MAX_META_LEN];
+    int index; //Grid position of the title shown, or -1 if the item is not bound
+    title_t *title; //The title shown, or NULL if the item is not bound
+    lv_obj_t *label;
+    lv_obj_t *canvas;
     jpg_info_t *jpg_info;
-} title_t;
+} scroller_item_t;
 
 #ifndef NANO_DEBUG_LEVEL
 #define NANO_DEBUG_LEVEL LEVEL_WARN
@@ -179,6 +310,7 @@ void dash_printf(dash_debug_level_t level, const char *format, ...);
 
 void dash_init(void);
 void dash_create();
+void dash_rescan(void);
 void dash_deinit(void);
 void lvgl_getlock(void);
 void lvgl_removelock(void);
@@ -21,6 +21,8 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
+/*DXT1 (BC1) compressed true colour image. 4x4 pixel blocks of 8 bytes, in rows from the top left*/
+#define LV_IMG_CF_DXT1 LV_IMG_CF_USER_ENCODED_0
 
 /**********************
  *      TYPEDEFS
@@ -31,6 +33,8 @@ extern "C" {
  **********************/
 void lv_port_disp_init(int width, int height);
 void lv_port_disp_deinit(void);
+void lv_img_dxt1_init(void);
+void lv_img_rgb565_init(void);
 /**********************
  *      MACROS
  **********************/
@@ -0,0 +1,104 @@
+//SPDX-License-Identifier: MIT
+
+#include "../lv_port_disp.h"
+#include "lvgl.h"
+
+// Software decoder for LV_IMG_CF_DXT1 images. Renderers that can draw DXT1 natively never get here.
+// Lines are decompressed as they are drawn so the image is never held uncompressed.
+
+static lv_res_t dxt1_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    LV_UNUSED(decoder);
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_VARIABLE)
+    {
+        return LV_RES_INV;
+    }
+
+    const lv_img_dsc_t *img_dsc = src;
+    if (img_dsc->header.cf != LV_IMG_CF_DXT1)
+    {
+        return LV_RES_INV;
+    }
+    *header = img_dsc->header;
+    return LV_RES_OK;
+}
+
+static lv_res_t dxt1_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    if (dsc->src_type != LV_IMG_SRC_VARIABLE || dsc->header.cf != LV_IMG_CF_DXT1)
+    {
+        return LV_RES_INV;
+    }
+    // Leaving img_data NULL makes lvgl read the image a line at a time
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
+
+static lv_color_t dxt1_unpack(uint16_t c)
+{
+    uint8_t r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    return lv_color_make((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+static lv_res_t dxt1_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc,
+                               lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t *buf)
+{
+    LV_UNUSED(decoder);
+    const lv_img_dsc_t *img_dsc = dsc->src;
+    const int blocks_per_row = (img_dsc->header.w + 3) / 4;
+    const uint8_t *block = &img_dsc->data[((y / 4) * blocks_per_row + (x / 4)) * 8];
+    const int shift = (y % 4) * 8;
+    lv_color_t *out = (lv_color_t *)buf;
+    lv_color_t palette[4];
+
+    // x is usually block aligned, so the palette for each block is only built once
+    int px = x % 4;
+    while (len > 0)
+    {
+        uint16_t c0 = block[0] | (block[1] << 8);
+        uint16_t c1 = block[2] | (block[3] << 8);
+        uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+        palette[0] = dxt1_unpack(c0);
+        palette[1] = dxt1_unpack(c1);
+        if (c0 > c1)
+        {
+            palette[2] = lv_color_mix(palette[0], palette[1], 171);
+            palette[3] = lv_color_mix(palette[0], palette[1], 85);
+        }
+        else
+        {
+            palette[2] = lv_color_mix(palette[0], palette[1], LV_OPA_50);
+            palette[3] = lv_color_black();
+        }
+
+        uint8_t row = indices >> shift;
+        for (; px < 4 && len > 0; px++, len--)
+        {
+            *out++ = palette[(row >> (px * 2)) & 0x3];
+        }
+        px = 0;
+        block += 8;
+    }
+    return LV_RES_OK;
+}
+
+static void dxt1_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    LV_UNUSED(dsc);
+}
+
+void lv_img_dxt1_init(void)
+{
+    static lv_img_decoder_t *decoder = NULL;
+    if (decoder != NULL)
+    {
+        return;
+    }
+    decoder = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(decoder, dxt1_info);
+    lv_img_decoder_set_open_cb(decoder, dxt1_open);
+    lv_img_decoder_set_read_line_cb(decoder, dxt1_read_line);
+    lv_img_decoder_set_close_cb(decoder, dxt1_close);
+}
@@ -0,0 +1,110 @@
+//SPDX-License-Identifier: MIT
+
+#include "../lv_port_disp.h"
+#include "lvgl.h"
+
+#if LV_COLOR_DEPTH == 32 && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Software decoder for LV_IMG_CF_RGB565 images. lvgl's built in decoder only handles true colour images at the
+// display colour depth. Renderers that can draw RGB565 natively never get here.
+// Lines are expanded as they are drawn so the image is never held at the display colour depth.
+
+static lv_res_t rgb565_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    LV_UNUSED(decoder);
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_VARIABLE)
+    {
+        return LV_RES_INV;
+    }
+
+    const lv_img_dsc_t *img_dsc = src;
+    if (img_dsc->header.cf != LV_IMG_CF_RGB565)
+    {
+        return LV_RES_INV;
+    }
+    *header = img_dsc->header;
+    return LV_RES_OK;
+}
+
+static lv_res_t rgb565_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    if (dsc->src_type != LV_IMG_SRC_VARIABLE || dsc->header.cf != LV_IMG_CF_RGB565)
+    {
+        return LV_RES_INV;
+    }
+    // Leaving img_data NULL makes lvgl read the image a line at a time
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
+
+static lv_color_t rgb565_unpack(uint16_t c)
+{
+    uint8_t r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    return lv_color_make((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+static lv_res_t rgb565_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc,
+                                 lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t *buf)
+{
+    LV_UNUSED(decoder);
+    const lv_img_dsc_t *img_dsc = dsc->src;
+    const uint8_t *in = &img_dsc->data[(y * img_dsc->header.w + x) * 2];
+    lv_color_t *out = (lv_color_t *)buf;
+
+#if LV_COLOR_DEPTH == 32 && defined(__SSE2__)
+    // 8 pixels at a time. Each channel is widened by repeating its top bits, exactly like rgb565_unpack
+    const __m128i mask_5 = _mm_set1_epi16(0x1F);
+    const __m128i mask_6 = _mm_set1_epi16(0x3F);
+    const __m128i alpha = _mm_set1_epi16((int16_t)0xFF00);
+    while (len >= 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)in);
+        __m128i r = _mm_srli_epi16(c, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(c, 5), mask_6);
+        __m128i b = _mm_and_si128(c, mask_5);
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        // lv_color32_t is stored as B, G, R, A
+        __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        __m128i ra = _mm_or_si128(r, alpha);
+        _mm_storeu_si128((__m128i *)&out[0], _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *)&out[4], _mm_unpackhi_epi16(bg, ra));
+        in += 16;
+        out += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len > 0)
+    {
+        *out++ = rgb565_unpack(in[0] | (in[1] << 8));
+        in += 2;
+        len--;
+    }
+    return LV_RES_OK;
+}
+
+static void rgb565_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    LV_UNUSED(dsc);
+}
+
+void lv_img_rgb565_init(void)
+{
+    static lv_img_decoder_t *decoder = NULL;
+    if (decoder != NULL)
+    {
+        return;
+    }
+    decoder = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(decoder, rgb565_info);
+    lv_img_decoder_set_open_cb(decoder, rgb565_open);
+    lv_img_decoder_set_read_line_cb(decoder, rgb565_read_line);
+    lv_img_decoder_set_close_cb(decoder, rgb565_close);
+}
@@ -4,8 +4,9 @@
 #include <SDL.h>
 #include "../../lv_port_disp.h"
 #include "lvgl.h"
+#include "lv_sdl_draw.h"
 
-static void *fb1, *fb2;
+static void *fb1;
 SDL_Window *window = NULL;
 SDL_Renderer *renderer = NULL;
 SDL_Texture *texture = NULL;
@@ -17,16 +18,80 @@ static int DISPLAY_HEIGHT;
 #define WINDOW_NAME "LVGL"
 #endif
 
+// Draw straight into the locked streaming texture instead of a separate buffer that is copied into it every
+// frame. Only used if the texture rows are packed the way lvgl expects, otherwise the copy is used.
+#ifndef LV_SDL_ZERO_COPY
+#define LV_SDL_ZERO_COPY 1
+#endif
+static bool zero_copy;
+
+static void texture_lock(lv_disp_drv_t *disp_drv)
+{
+    void *pixels = NULL;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0)
+    {
+        // Go back to drawing into our own buffer and copying it into the texture
+        zero_copy = false;
+        fb1 = malloc(DISPLAY_WIDTH * DISPLAY_HEIGHT * ((LV_COLOR_DEPTH + 7) / 8));
+        assert(fb1);
+        pixels = fb1;
+    }
+    if (pixels != disp_drv->draw_buf->buf1)
+    {
+        // The renderer has moved the texture memory or we have gone back to our own buffer, so the last frame
+        // is not in it. Redraw the whole screen each time from now on.
+        disp_drv->draw_buf->buf1 = pixels;
+        disp_drv->draw_buf->buf_act = pixels;
+        disp_drv->direct_mode = 0;
+        disp_drv->full_refresh = 1;
+    }
+}
+
+// In direct mode lvgl only redraws the invalidated areas, straight into the screen sized buffer at their screen
+// position. This is called once per area with the whole buffer. Once the last area of the frame is drawn, just
+// those areas are uploaded to the texture and the frame is presented once. Nothing is called while the screen
+// is unchanged.
 static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
 {
-    SDL_Rect r;
-    r.x = area->x1;
-    r.y = area->y1;
-    r.w = area->x2 - area->x1 + 1;
-    r.h = area->y2 - area->y1 + 1;
-    SDL_UpdateTexture(texture, &r, color_p, r.w * ((LV_COLOR_DEPTH + 7) / 8));
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+    LV_UNUSED(area);
+    if (lv_disp_flush_is_last(disp_drv) && zero_copy)
+    {
+        // lvgl drew straight into the texture, unlocking it is the upload
+        SDL_UnlockTexture(texture);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        texture_lock(disp_drv);
+    }
+    else if (lv_disp_flush_is_last(disp_drv) && disp_drv->full_refresh)
+    {
+        // Left zero copy mode part way through, the whole screen is drawn each time
+        SDL_UpdateTexture(texture, NULL, color_p, DISPLAY_WIDTH * ((LV_COLOR_DEPTH + 7) / 8));
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
+    else if (lv_disp_flush_is_last(disp_drv))
+    {
+        lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+        for (int i = 0; i < disp->inv_p; i++)
+        {
+            // Areas that were merged into another one are drawn as part of it
+            if (disp->inv_area_joined[i])
+            {
+                continue;
+            }
+            const lv_area_t *a = &disp->inv_areas[i];
+            SDL_Rect r;
+            r.x = a->x1;
+            r.y = a->y1;
+            r.w = lv_area_get_width(a);
+            r.h = lv_area_get_height(a);
+            SDL_UpdateTexture(texture, &r, &color_p[r.y * DISPLAY_WIDTH + r.x],
+                              DISPLAY_WIDTH * ((LV_COLOR_DEPTH + 7) / 8));
+        }
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
     lv_disp_flush_ready(disp_drv);
 }
 
@@ -49,24 +114,49 @@ void lv_port_disp_init(int width, int height)
                                 DISPLAY_WIDTH,
                                 DISPLAY_HEIGHT);
 
-    fb1 = malloc(DISPLAY_WIDTH * DISPLAY_HEIGHT * ((LV_COLOR_DEPTH + 7) / 8));
-    fb2 = malloc(DISPLAY_WIDTH * DISPLAY_HEIGHT * ((LV_COLOR_DEPTH + 7) / 8));
-
-    lv_disp_draw_buf_init(&draw_buf, fb1, fb2, DISPLAY_WIDTH * DISPLAY_HEIGHT);
+    // A single buffer holds the whole screen. It always has the last frame in it, so only what changed is redrawn
+    void *pixels = NULL;
+    int pitch = 0;
+    zero_copy = LV_SDL_ZERO_COPY && SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0;
+    if (zero_copy && pitch != DISPLAY_WIDTH * ((LV_COLOR_DEPTH + 7) / 8))
+    {
+        // lvgl can only draw into rows with no padding between them
+        SDL_UnlockTexture(texture);
+        zero_copy = false;
+    }
+    if (zero_copy)
+    {
+        lv_memset_00(pixels, pitch * DISPLAY_HEIGHT);
+        lv_disp_draw_buf_init(&draw_buf, pixels, NULL, DISPLAY_WIDTH * DISPLAY_HEIGHT);
+    }
+    else
+    {
+        fb1 = malloc(DISPLAY_WIDTH * DISPLAY_HEIGHT * ((LV_COLOR_DEPTH + 7) / 8));
+        lv_disp_draw_buf_init(&draw_buf, fb1, NULL, DISPLAY_WIDTH * DISPLAY_HEIGHT);
+    }
     lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_ctx_init = lv_draw_sdl_simd_init_ctx;
+    disp_drv.draw_ctx_deinit = lv_draw_sdl_simd_deinit_ctx;
+    disp_drv.draw_ctx_size = sizeof(lv_draw_sw_ctx_t);
 
     disp_drv.hor_res = DISPLAY_WIDTH;
     disp_drv.ver_res = DISPLAY_HEIGHT;
     disp_drv.flush_cb = disp_flush;
     disp_drv.draw_buf = &draw_buf;
-    disp_drv.full_refresh = 1;
+    disp_drv.direct_mode = 1;
     lv_disp_drv_register(&disp_drv);
+    lv_img_dxt1_init();
+    lv_img_rgb565_init();
 }
 
 void lv_port_disp_deinit()
 {
+    if (zero_copy)
+    {
+        SDL_UnlockTexture(texture);
+    }
     free(fb1);
-    free(fb2);
+    fb1 = NULL;
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+#include <SDL.h>
+#include "lvgl.h"
+#include "lv_sdl_draw.h"
+
+// Software draw context for the SDL display. It is lvgl's own software renderer with the normal blend replaced
+// by SSE2 or AVX2 versions, picked at runtime from the CPU features. Solid fills, masked fills (glyphs and
+// anti-aliased edges) and image blends all end up here. Every pixel comes out exactly
+// as lv_draw_sw_blend_basic() would draw it, and anything else is passed on to it. lv_sdl_draw_test.c checks this.
+//
+// Image zoom and rotation are not accelerated. lvgl's own transform still works out the pixels, only blending its
+// result onto the screen comes through here.
+//
+// Large blends are also split into horizontal bands that are blended at the same time on a pool of threads. Each
+// band gets its own copy of the draw context clipped to its rows, so no two threads touch the same pixels, and
+// they are all joined before the blend returns. lvgl itself only ever runs on the calling thread.
+
+#if LV_COLOR_DEPTH == 32 && LV_COLOR_MIX_ROUND_OFS == 0 && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define SDL_DRAW_SIMD 1
+#include <immintrin.h>
+#else
+#define SDL_DRAW_SIMD 0
+#endif
+
+#ifndef LV_SDL_DRAW_THREADS
+#define LV_SDL_DRAW_THREADS 0 // Threads blending in bands, including the caller. <= 0 uses one per CPU core
+#endif
+#define SDL_DRAW_MAX_THREADS 8
+#define SDL_DRAW_BAND_MIN_PIXELS (32 * 1024) // Smaller blends are done before the threads could even wake up
+#define SDL_DRAW_BAND_MIN_ROWS 8
+
+#if SDL_DRAW_SIMD
+// Blend a row of w pixels onto dest. src is NULL for a solid colour fill, mask is NULL if every pixel is covered.
+typedef void (*blend_row_t)(lv_color_t *dest, const lv_color_t *src, lv_color_t color, const lv_opa_t *mask,
+                            lv_opa_t opa, int32_t w);
+static blend_row_t blend_row;
+
+// One pixel, the way lvgl's fill_normal() and map_normal() do it. Uncovered pixels are left alone, fully covered
+// ones are copied and the rest are mixed.
+static inline lv_color_t blend_px(lv_color_t c, lv_color_t d, lv_opa_t m, lv_opa_t opa)
+{
+    if (m == LV_OPA_TRANSP)
+    {
+        return d;
+    }
+    lv_opa_t a = (opa == LV_OPA_COVER) ? m : (m >= LV_OPA_MAX) ? opa : (lv_opa_t)((opa * m) >> 8);
+    return (a == LV_OPA_COVER) ? c : lv_color_mix(c, d, a);
+}
+
+static void blend_row_tail(lv_color_t *dest, const lv_color_t *src, lv_color_t color, const lv_opa_t *mask,
+                           lv_opa_t opa, int32_t x, int32_t w)
+{
+    for (; x < w; x++)
+    {
+        dest[x] = blend_px(src ? src[x] : color, dest[x], mask ? mask[x] : LV_OPA_COVER, opa);
+    }
+}
+
+// Images at full opacity with no mask are a straight copy, the same as lvgl does it
+static void copy_row(lv_color_t *dest, const lv_color_t *src, lv_color_t color, const lv_opa_t *mask, lv_opa_t opa,
+                     int32_t w)
+{
+    LV_UNUSED(color);
+    LV_UNUSED(mask);
+    LV_UNUSED(opa);
+    memcpy(dest, src, w * sizeof(lv_color_t));
+}
+
+// LV_UDIV255 on 16 bit lanes. (x * 0x8081) >> 23 is the high half of the product shifted by 7
+#define SSE2_UDIV255(x) _mm_srli_epi16(_mm_mulhi_epu16((x), _mm_set1_epi16((short)0x8081)), 7)
+#define AVX2_UDIV255(x) _mm256_srli_epi16(_mm256_mulhi_epu16((x), _mm256_set1_epi16((short)0x8081)), 7)
+
+// Work out the mix factor of each pixel from its coverage, in 16 bit lanes
+__attribute__((target("sse2")))
+static inline __m128i sse2_get_alpha(__m128i m, lv_opa_t opa)
+{
+    if (opa == LV_OPA_COVER)
+    {
+        return m;
+    }
+    __m128i opa16 = _mm_set1_epi16(opa);
+    __m128i scaled = _mm_srli_epi16(_mm_mullo_epi16(m, opa16), 8);
+    __m128i full = _mm_cmpgt_epi16(m, _mm_set1_epi16(LV_OPA_MAX - 1));
+    return _mm_or_si128(_mm_and_si128(full, opa16), _mm_andnot_si128(full, scaled));
+}
+
+// c * a + d * (255 - a) / 255 for two pixels of 4 channels
+__attribute__((target("sse2")))
+static inline __m128i sse2_mix(__m128i c, __m128i d, __m128i a)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+    return SSE2_UDIV255(x);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_select(__m128i sel, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(sel, a), _mm_andnot_si128(sel, b));
+}
+
+__attribute__((target("sse2")))
+static void blend_row_sse2(lv_color_t *dest, const lv_color_t *src, lv_color_t color, const lv_opa_t *mask,
+                           lv_opa_t opa, int32_t w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color4 = _mm_set1_epi32((int)color.full);
+    int32_t x = 0;
+
+    if (src == NULL && mask == NULL && opa == LV_OPA_COVER)
+    {
+        for (; x + 4 <= w; x += 4)
+        {
+            _mm_storeu_si128((__m128i *)&dest[x], color4);
+        }
+        blend_row_tail(dest, src, color, mask, opa, x, w);
+        return;
+    }
+
+    for (; x + 4 <= w; x += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)&dest[x]);
+        __m128i s = (src) ? _mm_loadu_si128((const __m128i *)&src[x]) : color4;
+        __m128i m = _mm_set1_epi16(LV_OPA_COVER);
+        if (mask)
+        {
+            uint32_t m32;
+            memcpy(&m32, &mask[x], sizeof(m32));
+            if (m32 == 0)
+            {
+                continue;
+            }
+            m = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)m32), zero);
+        }
+        __m128i a = sse2_get_alpha(m, opa);
+
+        // Spread the factor of each pixel over its 4 channels
+        __m128i a2 = _mm_unpacklo_epi16(a, a);
+        __m128i a_lo = _mm_unpacklo_epi32(a2, a2);
+        __m128i a_hi = _mm_unpackhi_epi32(a2, a2);
+        __m128i r_lo = sse2_mix(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), a_lo);
+        __m128i r_hi = sse2_mix(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), a_hi);
+        __m128i r = _mm_or_si128(_mm_packus_epi16(r_lo, r_hi), _mm_set1_epi32((int)0xFF000000));
+
+        // Fully covered pixels are a copy of the source, uncovered ones are not touched
+        __m128i cover = _mm_cmpeq_epi16(a, _mm_set1_epi16(LV_OPA_COVER));
+        __m128i transp = _mm_cmpeq_epi16(m, zero);
+        r = sse2_select(_mm_unpacklo_epi16(cover, cover), s, r);
+        r = sse2_select(_mm_unpacklo_epi16(transp, transp), d, r);
+        _mm_storeu_si128((__m128i *)&dest[x], r);
+    }
+    blend_row_tail(dest, src, color, mask, opa, x, w);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_mix(__m256i c, __m256i d, __m256i a)
+{
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(c, a),
+                                 _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), a)));
+    return AVX2_UDIV255(x);
+}
+
+__attribute__((target("avx2")))
+static void blend_row_avx2(lv_color_t *dest, const lv_color_t *src, lv_color_t color, const lv_opa_t *mask,
+                           lv_opa_t opa, int32_t w)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i color8 = _mm256_set1_epi32((int)color.full);
+    int32_t x = 0;
+
+    if (src == NULL && mask == NULL && opa == LV_OPA_COVER)
+    {
+        for (; x + 8 <= w; x += 8)
+        {
+            _mm256_storeu_si256((__m256i *)&dest[x], color8);
+        }
+        blend_row_tail(dest, src, color, mask, opa, x, w);
+        return;
+    }
+
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dest[x]);
+        __m256i s = (src) ? _mm256_loadu_si256((const __m256i *)&src[x]) : color8;
+        __m128i m = _mm_set1_epi16(LV_OPA_COVER);
+        if (mask)
+        {
+            uint64_t m64;
+            memcpy(&m64, &mask[x], sizeof(m64));
+            if (m64 == 0)
+            {
+                continue;
+            }
+            m = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)&mask[x]));
+        }
+        __m128i a = sse2_get_alpha(m, opa);
+
+        // The 256 bit unpacks work within each 128 bit half, so the low half of each result holds pixels 0, 1
+        // and 4, 5 and the high half pixels 2, 3 and 6, 7. The factors are spread to match.
+        __m128i a_0123 = _mm_unpacklo_epi16(a, a);
+        __m128i a_4567 = _mm_unpackhi_epi16(a, a);
+        __m256i a_lo = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi32(a_0123, a_0123)),
+                                               _mm_unpacklo_epi32(a_4567, a_4567), 1);
+        __m256i a_hi = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpackhi_epi32(a_0123, a_0123)),
+                                               _mm_unpackhi_epi32(a_4567, a_4567), 1);
+        __m256i r_lo = avx2_mix(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), a_lo);
+        __m256i r_hi = avx2_mix(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), a_hi);
+        __m256i r = _mm256_or_si256(_mm256_packus_epi16(r_lo, r_hi), _mm256_set1_epi32((int)0xFF000000));
+
+        // Fully covered pixels are a copy of the source, uncovered ones are not touched
+        __m256i cover = _mm256_cvtepi16_epi32(_mm_cmpeq_epi16(a, _mm_set1_epi16(LV_OPA_COVER)));
+        __m256i transp = _mm256_cvtepi16_epi32(_mm_cmpeq_epi16(m, _mm_setzero_si128()));
+        r = _mm256_blendv_epi8(r, s, cover);
+        r = _mm256_blendv_epi8(r, d, transp);
+        _mm256_storeu_si256((__m256i *)&dest[x], r);
+    }
+    blend_row_tail(dest, src, color, mask, opa, x, w);
+}
+
+// Blend the part of dsc that is inside the clip area of draw_ctx. Only called for blends sdl_draw_blend() takes on.
+static void blend_rows(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    const lv_opa_t *mask = (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER) ? NULL : dsc->mask_buf;
+    lv_opa_t opa = dsc->opa;
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area))
+    {
+        return;
+    }
+
+    lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    lv_color_t *dest_buf = draw_ctx->buf;
+    dest_buf += dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+
+    const lv_color_t *src_buf = dsc->src_buf;
+    lv_coord_t src_stride = 0;
+    if (src_buf)
+    {
+        src_stride = lv_area_get_width(dsc->blend_area);
+        src_buf += src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+    }
+
+    lv_coord_t mask_stride = 0;
+    if (mask)
+    {
+        mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (blend_area.y1 - dsc->mask_area->y1) + (blend_area.x1 - dsc->mask_area->x1);
+    }
+
+    blend_row_t row = (src_buf && mask == NULL && opa == LV_OPA_COVER) ? copy_row : blend_row;
+    int32_t w = lv_area_get_width(&blend_area);
+    int32_t h = lv_area_get_height(&blend_area);
+    for (int32_t y = 0; y < h; y++)
+    {
+        row(dest_buf, src_buf, dsc->color, mask, opa, w);
+        dest_buf += dest_stride;
+        src_buf = (src_buf) ? src_buf + src_stride : NULL;
+        mask = (mask) ? mask + mask_stride : NULL;
+    }
+}
+
+static int band_num_threads;                               // Threads blending bands, including the caller
+static SDL_Thread *band_threads[SDL_DRAW_MAX_THREADS - 1]; // Workers, the caller blends bands too
+static SDL_sem *band_start;                                // Posted once for each worker needed by a blend
+static SDL_sem *band_done;                                 // Posted by a worker once there are no bands left
+static SDL_atomic_t band_next;                             // Next band of the current blend to be taken
+static bool band_running;                                  // Cleared to make the workers quit
+static int band_users;                                     // Draw contexts sharing the workers
+
+// The blend currently being split up. Only changed by the caller while every worker is waiting.
+static struct
+{
+    lv_draw_ctx_t *draw_ctx;
+    const lv_draw_sw_blend_dsc_t *dsc;
+    lv_area_t area;
+    lv_coord_t rows;
+    int count;
+} band_job;
+
+static void band_run(void)
+{
+    int band;
+    while ((band = SDL_AtomicAdd(&band_next, 1)) < band_job.count)
+    {
+        lv_area_t clip = band_job.area;
+        clip.y1 = band_job.area.y1 + band * band_job.rows;
+        clip.y2 = LV_MIN(clip.y1 + band_job.rows - 1, band_job.area.y2);
+
+        lv_draw_sw_ctx_t band_ctx = *(lv_draw_sw_ctx_t *)band_job.draw_ctx;
+        band_ctx.base_draw.clip_area = &clip;
+        blend_rows(&band_ctx.base_draw, band_job.dsc);
+    }
+}
+
+static int band_thread_f(void *arg)
+{
+    LV_UNUSED(arg);
+    while (1)
+    {
+        SDL_SemWait(band_start);
+        if (band_running == false)
+        {
+            break;
+        }
+        band_run();
+        SDL_SemPost(band_done);
+    }
+    return 0;
+}
+
+static void band_init(void)
+{
+    if (band_users++ > 0)
+    {
+        return;
+    }
+
+    int num_threads = LV_SDL_DRAW_THREADS;
+    if (num_threads <= 0)
+    {
+        num_threads = SDL_GetCPUCount();
+    }
+    num_threads = LV_CLAMP(1, num_threads, SDL_DRAW_MAX_THREADS);
+
+    band_start = SDL_CreateSemaphore(0);
+    band_done = SDL_CreateSemaphore(0);
+    band_running = true;
+    band_num_threads = 1;
+    for (int i = 0; i < num_threads - 1 && band_start && band_done; i++)
+    {
+        band_threads[i] = SDL_CreateThread(band_thread_f, "lv_sdl_draw_band", NULL);
+        if (band_threads[i] == NULL)
+        {
+            break;
+        }
+        band_num_threads++;
+    }
+}
+
+static void band_deinit(void)
+{
+    if (--band_users > 0)
+    {
+        return;
+    }
+
+    band_running = false;
+    for (int i = 0; i < band_num_threads - 1; i++)
+    {
+        SDL_SemPost(band_start);
+    }
+    for (int i = 0; i < band_num_threads - 1; i++)
+    {
+        SDL_WaitThread(band_threads[i], NULL);
+    }
+    SDL_DestroySemaphore(band_start);
+    SDL_DestroySemaphore(band_done);
+    band_start = NULL;
+    band_done = NULL;
+    band_num_threads = 0;
+}
+
+static void sdl_draw_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    lv_opa_t opa = dsc->opa;
+
+    // Opacities between LV_OPA_MAX and LV_OPA_COVER and other blend modes are left to lvgl
+    if (dsc->blend_mode != LV_BLEND_MODE_NORMAL || disp->driver->set_px_cb || disp->driver->screen_transp ||
+        (opa >= LV_OPA_MAX && opa != LV_OPA_COVER))
+    {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    if (dsc->mask_buf && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP)
+    {
+        return;
+    }
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area))
+    {
+        return;
+    }
+
+    lv_coord_t h = lv_area_get_height(&blend_area);
+    int count = LV_MIN(band_num_threads, h / SDL_DRAW_BAND_MIN_ROWS);
+    if (count < 2 || (uint32_t)lv_area_get_width(&blend_area) * h < SDL_DRAW_BAND_MIN_PIXELS)
+    {
+        blend_rows(draw_ctx, dsc);
+        return;
+    }
+
+    band_job.draw_ctx = draw_ctx;
+    band_job.dsc = dsc;
+    band_job.area = blend_area;
+    band_job.rows = (h + count - 1) / count;
+    band_job.count = count;
+    SDL_AtomicSet(&band_next, 0);
+    for (int i = 0; i < count - 1; i++)
+    {
+        SDL_SemPost(band_start);
+    }
+    band_run();
+    for (int i = 0; i < count - 1; i++)
+    {
+        SDL_SemWait(band_done);
+    }
+}
+#endif
+
+void lv_draw_sdl_simd_init_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+
+#if SDL_DRAW_SIMD
+    if (SDL_HasAVX2())
+    {
+        blend_row = blend_row_avx2;
+    }
+    else if (SDL_HasSSE2())
+    {
+        blend_row = blend_row_sse2;
+    }
+
+    if (blend_row)
+    {
+        band_init();
+        ((lv_draw_sw_ctx_t *)draw_ctx)->blend = sdl_draw_blend;
+    }
+#endif
+}
+
+void lv_draw_sdl_simd_deinit_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+#if SDL_DRAW_SIMD
+    if (((lv_draw_sw_ctx_t *)draw_ctx)->blend == sdl_draw_blend)
+    {
+        band_deinit();
+    }
+#endif
+    lv_draw_sw_deinit_ctx(drv, draw_ctx);
+}
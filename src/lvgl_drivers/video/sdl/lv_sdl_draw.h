@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef lv_draw_sdl_simd_H
+#define lv_draw_sdl_simd_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "src/draw/sw/lv_draw_sw.h"
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+void lv_draw_sdl_simd_init_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+void lv_draw_sdl_simd_deinit_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*lv_draw_sdl_simd_H*/
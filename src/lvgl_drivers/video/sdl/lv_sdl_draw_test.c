@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: MIT
+
+// Checks that the SDL draw context blends exactly like lvgl's software renderer. Random fills, masked fills and
+// image blends are drawn by lv_draw_sw_blend_basic() into one buffer and through sdl_draw_blend() with each SIMD
+// kernel into another, and the two have to match byte for byte. Large blends are split into bands, so the band
+// threads are checked too.
+//
+// It is not part of the dashboard. Build and run it on a PC with:
+//   cmake --build build --target lv_sdl_draw_test && ./build/lv_sdl_draw_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lv_sdl_draw.c"
+
+#define TEST_BUF_W 320
+#define TEST_BUF_H 240
+#define TEST_BUF_X 16 // The draw buffer does not start at the screen origin, like a partial refresh
+#define TEST_BUF_Y 8
+#define TEST_AREA_MAX ((TEST_BUF_W + 16) * (TEST_BUF_H + 16)) // Blend areas can reach 8 pixels past each edge
+#define TEST_CASES 20000
+
+#if SDL_DRAW_SIMD
+static lv_color_t ref_buf[TEST_BUF_W * TEST_BUF_H];
+static lv_color_t simd_buf[TEST_BUF_W * TEST_BUF_H];
+static lv_color_t src_buf[TEST_AREA_MAX];
+static lv_opa_t mask_buf[TEST_AREA_MAX];
+
+static uint32_t rnd(void)
+{
+    static uint64_t s = 88172645463325252ULL;
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return (uint32_t)s;
+}
+
+static int32_t rnd_range(int32_t min, int32_t max)
+{
+    return min + (int32_t)(rnd() % (uint32_t)(max - min + 1));
+}
+
+// Mostly the values the kernels treat specially, some of everything else
+static lv_opa_t rnd_mask(void)
+{
+    switch (rnd() % 6)
+    {
+    case 0:
+        return LV_OPA_TRANSP;
+    case 1:
+        return LV_OPA_COVER;
+    case 2:
+        return (lv_opa_t)rnd_range(LV_OPA_MAX - 1, LV_OPA_COVER - 1);
+    default:
+        return (lv_opa_t)rnd();
+    }
+}
+
+// A random area, sometimes reaching past the buffer so the clip is exercised
+static void rnd_area(lv_area_t *area, const lv_area_t *within, bool large)
+{
+    lv_coord_t w = lv_area_get_width(within), h = lv_area_get_height(within);
+    area->x1 = within->x1 + rnd_range(-8, w - 1);
+    area->y1 = within->y1 + rnd_range(-8, h - 1);
+    area->x2 = area->x1 + (large ? rnd_range(w / 2, w + 8) : rnd_range(0, 70));
+    area->y2 = area->y1 + (large ? rnd_range(h / 2, h + 8) : rnd_range(0, 12));
+}
+
+static int run_cases(lv_draw_ctx_t *draw_ctx, const char *name)
+{
+    lv_area_t buf_area = {TEST_BUF_X, TEST_BUF_Y, TEST_BUF_X + TEST_BUF_W - 1, TEST_BUF_Y + TEST_BUF_H - 1};
+    int failures = 0;
+
+    for (int i = 0; i < TEST_CASES; i++)
+    {
+        lv_area_t blend_area, clip_area;
+        lv_draw_sw_blend_dsc_t dsc;
+        lv_area_t dest_area;
+        bool large = (i % 50) == 0;
+
+        rnd_area(&blend_area, &buf_area, large);
+        int32_t area_size = lv_area_get_width(&blend_area) * lv_area_get_height(&blend_area);
+        bool mask_empty = (rnd() % 4 == 0);
+        for (int32_t p = 0; p < area_size; p++)
+        {
+            src_buf[p].full = rnd();
+            mask_buf[p] = mask_empty ? LV_OPA_TRANSP : rnd_mask();
+        }
+
+        // Fresh destination pixels under the blend. Both buffers are the same everywhere before each blend.
+        if (_lv_area_intersect(&dest_area, &blend_area, &buf_area))
+        {
+            for (lv_coord_t y = dest_area.y1; y <= dest_area.y2; y++)
+            {
+                for (lv_coord_t x = dest_area.x1; x <= dest_area.x2; x++)
+                {
+                    int32_t p = (y - buf_area.y1) * TEST_BUF_W + (x - buf_area.x1);
+                    ref_buf[p].full = rnd();
+                    simd_buf[p] = ref_buf[p];
+                }
+            }
+        }
+
+        clip_area = buf_area;
+        if (rnd() % 2)
+        {
+            rnd_area(&clip_area, &buf_area, true);
+            _lv_area_intersect(&clip_area, &clip_area, &buf_area);
+        }
+
+        lv_memset_00(&dsc, sizeof(dsc));
+        dsc.blend_area = &blend_area;
+        dsc.src_buf = (rnd() % 2) ? src_buf : NULL;
+        dsc.color.full = rnd();
+        dsc.mask_buf = (rnd() % 3) ? mask_buf : NULL;
+        dsc.mask_area = &blend_area;
+        dsc.mask_res = (rnd() % 8 == 0) ? LV_DRAW_MASK_RES_FULL_COVER : LV_DRAW_MASK_RES_CHANGED;
+        dsc.opa = (rnd() % 3 == 0) ? LV_OPA_COVER : (lv_opa_t)rnd_range(LV_OPA_MIN + 1, LV_OPA_COVER);
+        dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+
+        draw_ctx->buf_area = &buf_area;
+        draw_ctx->clip_area = &clip_area;
+        draw_ctx->buf = ref_buf;
+        lv_draw_sw_blend_basic(draw_ctx, &dsc);
+        draw_ctx->buf = simd_buf;
+        sdl_draw_blend(draw_ctx, &dsc);
+
+        if (memcmp(ref_buf, simd_buf, sizeof(ref_buf)) != 0)
+        {
+            if (failures++ < 5)
+            {
+                printf("%s: case %d differs. area %d,%d %dx%d opa %d src %d mask %d\n", name, i,
+                       (int)blend_area.x1, (int)blend_area.y1, (int)lv_area_get_width(&blend_area),
+                       (int)lv_area_get_height(&blend_area), dsc.opa, dsc.src_buf != NULL, dsc.mask_buf != NULL);
+            }
+            lv_memcpy(simd_buf, ref_buf, sizeof(ref_buf));
+        }
+    }
+    printf("%s: %d of %d blends differ\n", name, failures, TEST_CASES);
+    return failures;
+}
+
+int main(void)
+{
+    static lv_disp_drv_t drv;
+    static lv_disp_t disp;
+    static lv_draw_sw_ctx_t draw_ctx;
+    int failures = 0;
+
+    lv_init();
+    for (int p = 0; p < TEST_BUF_W * TEST_BUF_H; p++)
+    {
+        ref_buf[p].full = rnd();
+    }
+    lv_memcpy(simd_buf, ref_buf, sizeof(ref_buf));
+    lv_disp_drv_init(&drv);
+    drv.screen_transp = 0;
+    disp.driver = &drv;
+    _lv_refr_set_disp_refreshing(&disp);
+
+    lv_draw_sdl_simd_init_ctx(&drv, &draw_ctx.base_draw);
+    if (SDL_HasSSE2())
+    {
+        blend_row = blend_row_sse2;
+        failures += run_cases(&draw_ctx.base_draw, "SSE2");
+    }
+    if (SDL_HasAVX2())
+    {
+        blend_row = blend_row_avx2;
+        failures += run_cases(&draw_ctx.base_draw, "AVX2");
+    }
+    lv_draw_sdl_simd_deinit_ctx(&drv, &draw_ctx.base_draw);
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#else
+int main(void)
+{
+    printf("The SIMD blend is not built for this lvgl configuration, lvgl's own blend is used\n");
+    return EXIT_SUCCESS;
+}
+#endif
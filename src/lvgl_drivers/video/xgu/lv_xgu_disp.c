@@ -61,6 +61,11 @@ void lv_port_disp_init(int width, int height)
     disp_drv.user_data = data;
     lv_disp_drv_register(&disp_drv);
 
+    // DXT1 and RGB565 images are drawn as native textures. The software decoders are still needed for lvgl to
+    // read their header.
+    lv_img_dxt1_init();
+    lv_img_rgb565_init();
+
     if (LV_COLOR_DEPTH == 16)
     {
         pb_set_color_format(NV097_SET_SURFACE_FORMAT_COLOR_LE_R5G6B5, false);
@@ -5,6 +5,7 @@
 #include "libs/xgu/xgu.h"
 #include "libs/xgu/xgux.h"
 #include "src/misc/lv_lru.h"
+#include "../../lv_port_disp.h"
 
 extern uint32_t *p;
 
@@ -81,8 +82,15 @@ static void bind_texture(lv_draw_xgu_ctx_t *xgu_ctx, draw_cache_value_t *texture
 {
     if (xgu_ctx->xgu_data->current_tex != tex_id)
     {
+        // Compressed textures are not linear, so they need their power of two size set here
+        uint32_t u_size = texture->tw >> 8, v_size = texture->th >> 8;
+        if (texture->format == XGU_TEXTURE_FORMAT_DXT1)
+        {
+            u_size = __builtin_ctz(texture->tw);
+            v_size = __builtin_ctz(texture->th);
+        }
         p = xgu_set_texture_offset(p, 0, (void *)MmGetPhysicalAddress(texture->texture));
-        p = xgu_set_texture_format(p, 0, 2, false, XGU_SOURCE_COLOR, 2, texture->format, 1, texture->tw >> 8, texture->th >> 8, 0);
+        p = xgu_set_texture_format(p, 0, 2, false, XGU_SOURCE_COLOR, 2, texture->format, 1, u_size, v_size, 0);
         p = xgu_set_texture_address(p, 0, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, false);
         p = xgu_set_texture_control0(p, 0, true, 0, 0);
         p = xgu_set_texture_control1(p, 0, texture->tw * texture->bytes_pp);
@@ -99,12 +107,28 @@ static void *create_texture(lv_draw_xgu_ctx_t *xgu_ctx, const uint8_t *src_buf,
     uint32_t ih = lv_area_get_height(src_area);
     uint32_t tw = npot2pot(iw);
     uint32_t th = npot2pot(ih);
-    uint32_t sz;
-    //Seems like there's a min texture size of 8 bytes.
-    //Fix me, small textures will still use a whole page of memory.
-    tw = LV_MAX(tw, 8 / bytes_pp);
-    th = LV_MAX(th, 8 / bytes_pp);
-    sz = tw * th * bytes_pp;
+    uint32_t sz, rows, src_pitch, dst_pitch;
+    if (fmt == XGU_TEXTURE_FORMAT_DXT1)
+    {
+        //4x4 pixel blocks of 8 bytes. bytes_pp is not used.
+        tw = LV_MAX(tw, 4);
+        th = LV_MAX(th, 4);
+        sz = tw * th / 2;
+        rows = (ih + 3) / 4;
+        src_pitch = ((iw + 3) / 4) * 8;
+        dst_pitch = (tw / 4) * 8;
+    }
+    else
+    {
+        //Seems like there's a min texture size of 8 bytes.
+        //Fix me, small textures will still use a whole page of memory.
+        tw = LV_MAX(tw, 8 / bytes_pp);
+        th = LV_MAX(th, 8 / bytes_pp);
+        sz = tw * th * bytes_pp;
+        rows = ih;
+        src_pitch = iw * bytes_pp;
+        dst_pitch = tw * bytes_pp;
+    }
 
     //Allocate it in cache
     texture = lv_mem_alloc(sizeof(draw_cache_value_t));
@@ -127,11 +151,11 @@ static void *create_texture(lv_draw_xgu_ctx_t *xgu_ctx, const uint8_t *src_buf,
     texture->texture = dst_buf;
 
     uint32_t dst_px = 0, src_px = 0;
-    for (int y = 0; y < ih; y++)
+    for (int y = 0; y < rows; y++)
     {
-        memcpy(&dst_buf[dst_px], &src_buf[src_px], iw * bytes_pp);
-        dst_px += tw * bytes_pp;
-        src_px += iw * bytes_pp;
+        memcpy(&dst_buf[dst_px], &src_buf[src_px], src_pitch);
+        dst_px += dst_pitch;
+        src_px += src_pitch;
     }
 
     return texture;
@@ -147,6 +171,15 @@ static void map_textured_rect(draw_cache_value_t *texture, const lv_area_t *tex_
     t0 = (float)(draw_area->y1 - tex_area->y1) / zm;
     t1 = texture->ih - ((float)(tex_area->y2 - draw_area->y2) / zm);
 
+    //Compressed textures use normalised texture coordinates
+    if (texture->format == XGU_TEXTURE_FORMAT_DXT1)
+    {
+        s0 /= texture->tw;
+        s1 /= texture->tw;
+        t0 /= texture->th;
+        t1 /= texture->th;
+    }
+
     p = xgu_begin(p, XGU_TRIANGLE_STRIP);
 
     p = xgux_set_texcoord3f(p, 0, s0, t0, 1);
@@ -260,6 +293,7 @@ lv_res_t xgu_draw_img(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *
     case LV_IMG_CF_RGBX8888:
     case LV_IMG_CF_RGB565:
     case LV_IMG_CF_INDEXED_1BIT:
+    case LV_IMG_CF_DXT1:
         break;
     case LV_IMG_CF_TRUE_COLOR_ALPHA:
         if (sizeof(lv_color_t) == 4) break;
@@ -321,6 +355,14 @@ void xgu_draw_img_decoded(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc
     uint32_t key = 0;
     uint32_t max = (lv_area_get_width(src_area) *
                lv_area_get_height(src_area) * sizeof(lv_color_t)) / 4;
+    if (cf == LV_IMG_CF_DXT1)
+    {
+        max = ((lv_area_get_width(src_area) + 3) / 4) * ((lv_area_get_height(src_area) + 3) / 4) * 8 / 4;
+    }
+    else if (cf == LV_IMG_CF_RGB565)
+    {
+        max = (lv_area_get_width(src_area) * lv_area_get_height(src_area) * 2) / 4;
+    }
     uint32_t *_src = (uint32_t *)src_buf;
     int i = 0, end = LV_MIN(i + 16, max);
     while (i < end) key += _src[i++];
@@ -361,6 +403,10 @@ void xgu_draw_img_decoded(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc
             xgu_cf = XGU_TEXTURE_FORMAT_R5G6B5;
             bytes_pp = 2;
             break;
+        case LV_IMG_CF_DXT1:
+            xgu_cf = XGU_TEXTURE_FORMAT_DXT1;
+            bytes_pp = 0;
+            break;
         case LV_IMG_CF_INDEXED_1BIT:
             xgu_cf = XGU_TEXTURE_FORMAT_A8;
             bytes_pp = 1;
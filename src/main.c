@@ -20,6 +20,7 @@ keyboard_map_t lvgl_keyboard_map[] =
     {.sdl_map = SDLK_DOWN, .lvgl_map = LV_KEY_DOWN},
     {.sdl_map = SDLK_LEFT, .lvgl_map = LV_KEY_LEFT},
     {.sdl_map = SDLK_RIGHT, .lvgl_map = LV_KEY_RIGHT},
+    {.sdl_map = SDLK_TAB, .lvgl_map = DASH_JUMP_INDEX},
     {.sdl_map = 0, .lvgl_map = 0}
 };
 
@@ -33,7 +34,7 @@ gamecontroller_map_t lvgl_gamecontroller_map[] =
     {.sdl_map = SDL_CONTROLLER_BUTTON_GUIDE, .lvgl_map = 0},
     {.sdl_map = SDL_CONTROLLER_BUTTON_START, .lvgl_map = DASH_SETTINGS_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_LEFTSTICK, .lvgl_map = 0},
-    {.sdl_map = SDL_CONTROLLER_BUTTON_RIGHTSTICK, .lvgl_map = 0},
+    {.sdl_map = SDL_CONTROLLER_BUTTON_RIGHTSTICK, .lvgl_map = DASH_JUMP_INDEX},
     {.sdl_map = SDL_CONTROLLER_BUTTON_LEFTSHOULDER, .lvgl_map = DASH_PREV_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_RIGHTSHOULDER, .lvgl_map = DASH_NEXT_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_DPAD_UP, .lvgl_map = LV_KEY_UP},
@@ -157,6 +158,7 @@ int main(int argc, char* argv[]) {
         #endif
     }
     dash_printf(LEVEL_TRACE, "Quitting dash with quit event %d\n", lv_get_quit());
+    dash_thumbcache_deinit();
     lv_port_disp_deinit();
     lv_port_indev_deinit();
     platform_quit(lv_get_quit());
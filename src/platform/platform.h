@@ -37,6 +37,12 @@ void platform_flush_cache(void);
  */
 void platform_get_iso8601_time(char time_str[20]);
 
+/*
+ * Retrieve the amount of free physical memory in bytes.
+ * Used at startup to size caches
+ */
+size_t platform_get_free_memory(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,17 @@ void platform_flush_cache()
 
 }
 
+size_t platform_get_free_memory(void)
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status) == FALSE)
+    {
+        return 0;
+    }
+    return (status.ullAvailPhys > SIZE_MAX) ? SIZE_MAX : (size_t)status.ullAvailPhys;
+}
+
 void platform_get_iso8601_time(char time_str[20])
 {
     SYSTEMTIME st;
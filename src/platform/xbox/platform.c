@@ -347,11 +347,17 @@ void info_update_callback(lv_timer_t *timer)
 
     encoder = get_encoder_str();
 
+    dash_thumbcache_stats_t thumb_stats;
+    dash_thumbcache_get_stats(&thumb_stats);
+    ULONG thumb_lookups = thumb_stats.hits + thumb_stats.misses;
+    ULONG thumb_hit_rate = (thumb_lookups) ? (thumb_stats.hits * 100ULL / thumb_lookups) : 0;
+
     lv_snprintf(info_text, sizeof(info_text),
                 "%s Date/Time:# %s\n"
                 "%s IP:# %s\n"
                 "%s Tray State:# %s\n"
                 "%s RAM:# %s MB\n"
+                "%s Thumbnail Cache:# %lu/%lu MB, %lu%% hits, %lu evicted\n"
                 "%s CPU:# %lu%c, %s MB:# %lu%c\n"
                 "%s CPU Freq:# %luMHz, %s GPU Freq:# %luMHz\n"
                 "%s Hardware Version:# %s\n"
@@ -366,6 +372,8 @@ void info_update_callback(lv_timer_t *timer)
                 DASH_MENU_COLOR, xbox_get_ip_address(),
                 DASH_MENU_COLOR, tray_state_str(platform_tray_state),
                 DASH_MENU_COLOR, xbox_get_ram_usage(),
+                DASH_MENU_COLOR, (ULONG)(thumb_stats.resident_bytes / 1024U / 1024U),
+                (ULONG)(thumb_stats.budget_bytes / 1024U / 1024U), thumb_hit_rate, (ULONG)thumb_stats.evictions,
                 DASH_MENU_COLOR, platform_cpu_temp, platform_temp_unit, DASH_MENU_COLOR, platform_mb_temp, platform_temp_unit,
                 DASH_MENU_COLOR, cpu_speed, DASH_MENU_COLOR, gpu_speed,
                 DASH_MENU_COLOR, xbox_get_verion(),
@@ -449,6 +457,14 @@ void platform_get_iso8601_time(char time_str[20])
                 st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
 }
 
+size_t platform_get_free_memory(void)
+{
+    MM_STATISTICS MemoryStatistics;
+    MemoryStatistics.Length = sizeof(MM_STATISTICS);
+    MmQueryStatistics(&MemoryStatistics);
+    return MemoryStatistics.AvailablePages * PAGE_SIZE;
+}
+
 /*
  * Copyright (C) 2014, Galois, Inc.
  * This sotware is distributed under a standard, three-clause BSD license.